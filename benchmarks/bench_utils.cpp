@@ -0,0 +1,673 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+// Benchmarks of the talker/listener and thread primitives. Every result is printed to stdout
+// as a single line JSON object, so the output can be stored and compared between releases:
+//   $ ./bench_utils > results.jsonl
+// An optional argument selects benchmarks whose name starts with it, e.g. ./bench_utils broadcast
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <generic_thread.h>
+#include <locks.h>
+#include <monotonic_clock.h>
+#include <scoped_lock.h>
+#include <static_talker.h>
+
+
+namespace
+{
+/** Prefix of benchmark names to run. */
+const char* filter = "";
+
+/**
+ *  @param name the name of a benchmark.
+ *  @return true if the benchmark was selected in the command line.
+ */
+bool isSelected(const char* name)
+{
+    return 0 == strncmp(name, filter, strlen(filter));
+}
+
+/**
+ * Collects latency samples and prints them together with throughput.
+ */
+class Report
+{
+public:
+    explicit Report(const char* name) : mName(name), mParams(), mOperations(0), mElapsed(0)
+    {
+    }
+
+    void param(const char* key, const long value)
+    {
+        mParams += ",\"" + std::string(key) + "\":" + std::to_string(value);
+    }
+
+    void param(const char* key, const char* value)
+    {
+        mParams += ",\"" + std::string(key) + "\":\"" + value + "\"";
+    }
+
+    void add(const std::vector<int64_t>& samples)
+    {
+        mSamples.insert(mSamples.end(), samples.begin(), samples.end());
+    }
+
+    void add(const int64_t sample)
+    {
+        mSamples.push_back(sample);
+    }
+
+    /**
+     * Sets the throughput.
+     *  @param operations the number of operations done in total.
+     *  @param elapsed wall time of all operations in nanoseconds.
+     */
+    void throughput(const long operations, const int64_t elapsed)
+    {
+        mOperations = operations;
+        mElapsed = elapsed;
+    }
+
+    void print()
+    {
+        std::sort(mSamples.begin(), mSamples.end());
+        printf("{\"benchmark\":\"%s\"%s,\"operations\":%ld,\"ops_per_sec\":%.1f,"
+               "\"p50_ns\":%ld,\"p99_ns\":%ld,\"p999_ns\":%ld,\"max_ns\":%ld}\n",
+               mName, mParams.c_str(), mOperations,
+               mElapsed > 0 ? static_cast<double>(mOperations) * 1e9 / static_cast<double>(mElapsed) : 0.0,
+               percentile(0.5), percentile(0.99), percentile(0.999), mSamples.empty() ? 0L : static_cast<long>(mSamples.back()));
+        fflush(stdout);
+    }
+
+private:
+    long percentile(const double p) const
+    {
+        return mSamples.empty() ? 0L : static_cast<long>(mSamples[static_cast<size_t>(p * static_cast<double>(mSamples.size() - 1))]);
+    }
+
+    const char* mName;
+    std::string mParams;
+    std::vector<int64_t> mSamples;
+    long mOperations;
+    int64_t mElapsed;
+};
+
+template<size_t Size>
+struct Payload
+{
+    uint8_t mBytes[Size];
+};
+
+template<size_t Size>
+class BenchListener : public GenericListener<Payload<Size>>
+{
+public:
+    BenchListener() : mSum(0) {}
+
+    void update(const Payload<Size>& data) override
+    {
+        // publishers of the snapshot mode update a listener concurrently, so the sum has to be atomic.
+        mSum.fetch_add(data.mBytes[0] + data.mBytes[Size - 1], std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> mSum;
+};
+
+template<size_t Size>
+class BenchTalker : public GenericTalker<Payload<Size>>
+{
+public:
+    explicit BenchTalker(const BroadcastMode mode) : GenericTalker<Payload<Size>>(mode) {}
+
+    inline void publish(const Payload<Size>& data) const
+    {
+        this->notifyListeners(data);
+    }
+};
+
+/**
+ * Thread that publishes a given number of samples and records the latency of each broadcast.
+ */
+template<size_t Size>
+class Publisher : public GenericThread<Publisher<Size>>
+{
+public:
+    Publisher(const BenchTalker<Size>& talker, const long iterations, const std::atomic<bool>& go)
+    : mTalker(talker), mIterations(iterations), mGo(go)
+    {
+        memset(&mPayload, 1, sizeof(mPayload));
+        mSamples.reserve(iterations);
+    }
+
+    void* threadBody()
+    {
+        while (!mGo.load(std::memory_order_acquire))
+        {
+            sched_yield();
+        }
+        for (long i = 0; i < mIterations; ++i)
+        {
+            int64_t start = monotonicNow();
+            mTalker.publish(mPayload);
+            mSamples.push_back(monotonicNow() - start);
+        }
+        return nullptr;
+    }
+
+    const BenchTalker<Size>& mTalker;
+    const long mIterations;
+    const std::atomic<bool>& mGo;
+    Payload<Size> mPayload;
+    std::vector<int64_t> mSamples;
+};
+
+/**
+ * Thread that keeps registering and unregistering a listener at a given rate.
+ */
+template<size_t Size>
+class Churner : public GenericThread<Churner<Size>>
+{
+public:
+    Churner(BenchTalker<Size>& talker, const long rate) : mTalker(talker), mRate(rate), mCycles(0) {}
+
+    void* threadBody()
+    {
+        const int64_t period = 1000000000 / mRate;
+        int64_t next = monotonicNow();
+        while (this->isRunning())
+        {
+            mTalker.registerTo(&mListener);
+            mTalker.unregisterFrom(&mListener);
+            ++mCycles;
+            next += period;
+            while (this->isRunning() && monotonicNow() < next)
+            {
+                sched_yield();
+            }
+        }
+        return nullptr;
+    }
+
+    BenchTalker<Size>& mTalker;
+    const long mRate;
+    long mCycles;
+    BenchListener<Size> mListener;
+};
+
+/**
+ *  @return the name of a broadcast mode.
+ */
+const char* toString(const BroadcastMode mode)
+{
+    switch (mode)
+    {
+        case BroadcastMode::SNAPSHOT:
+            return "snapshot";
+        case BroadcastMode::CONCURRENT:
+            return "concurrent";
+        default:
+            return "exclusive";
+    }
+}
+
+/**
+ * Measures notifyListeners with a given number of listeners, publishers and registration churn.
+ *  @param churnRate registrations per second done by a separate thread, 0 disables churn.
+ */
+template<size_t Size>
+void benchBroadcast(const char* name, const BroadcastMode mode, const size_t listenerCount, const int publisherCount, const long churnRate)
+{
+    BenchTalker<Size> talker(mode);
+    std::vector<BenchListener<Size>> listeners(listenerCount);
+    for (BenchListener<Size>& listener : listeners)
+    {
+        talker.registerTo(&listener);
+    }
+
+    const long iterations = std::max(200L, 2000000L / static_cast<long>(listenerCount + 10) / publisherCount);
+    std::atomic<bool> go(false);
+    std::vector<std::unique_ptr<Publisher<Size>>> publishers;
+    for (int i = 0; i < publisherCount; ++i)
+    {
+        publishers.emplace_back(new Publisher<Size>(talker, iterations, go));
+        publishers.back()->startThread();
+    }
+    Churner<Size> churner(talker, std::max(1L, churnRate));
+    if (churnRate > 0)
+    {
+        churner.startThread();
+    }
+
+    int64_t start = monotonicNow();
+    go.store(true, std::memory_order_release);
+    for (std::unique_ptr<Publisher<Size>>& publisher : publishers)
+    {
+        publisher->stopThread();
+    }
+    int64_t elapsed = monotonicNow() - start;
+    churner.stopThread();
+
+    Report report(name);
+    report.param("mode", toString(mode));
+    report.param("listeners", static_cast<long>(listenerCount));
+    report.param("payload_bytes", static_cast<long>(Size));
+    report.param("publishers", publisherCount);
+    report.param("churn_per_sec", churnRate);
+    for (std::unique_ptr<Publisher<Size>>& publisher : publishers)
+    {
+        report.add(publisher->mSamples);
+    }
+    report.throughput(iterations * publisherCount, elapsed);
+    report.print();
+}
+
+/**
+ * Measures registerTo and unregisterFrom while the talker already holds a number of listeners.
+ */
+void benchRegistration(const BroadcastMode mode, const size_t listenerCount)
+{
+    BenchTalker<8> talker(mode);
+    std::vector<BenchListener<8>> listeners(listenerCount);
+    Report registration("register");
+    Report unregistration("unregister");
+
+    int64_t start = monotonicNow();
+    for (BenchListener<8>& listener : listeners)
+    {
+        int64_t begin = monotonicNow();
+        talker.registerTo(&listener);
+        registration.add(monotonicNow() - begin);
+    }
+    registration.throughput(static_cast<long>(listenerCount), monotonicNow() - start);
+
+    start = monotonicNow();
+    for (BenchListener<8>& listener : listeners)
+    {
+        int64_t begin = monotonicNow();
+        talker.unregisterFrom(&listener);
+        unregistration.add(monotonicNow() - begin);
+    }
+    unregistration.throughput(static_cast<long>(listenerCount), monotonicNow() - start);
+
+    for (Report* report : {&registration, &unregistration})
+    {
+        report->param("mode", toString(mode));
+        report->param("listeners", static_cast<long>(listenerCount));
+        report->print();
+    }
+}
+
+/**
+ * Listener of scalar samples that processes batches in a vectorisable loop.
+ */
+class SampleListener : public GenericListener<float>
+{
+public:
+    SampleListener() : mSum(0.0f) {}
+
+    void update(const float& sample) override
+    {
+        mSum += sample;
+    }
+
+    void updateBatch(const float* samples, const size_t count) override
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+        {
+            sum += samples[i];
+        }
+        mSum += sum;
+    }
+
+    float mSum;
+};
+
+class SampleTalker : public GenericTalker<float>
+{
+public:
+    explicit SampleTalker(const BroadcastMode mode) : GenericTalker<float>(mode) {}
+
+    inline void publish(const float* samples, const size_t count) const
+    {
+        if (1 == count)
+        {
+            notifyListeners(*samples);
+        }
+        else
+        {
+            notifyListenersBatch(samples, count);
+        }
+    }
+};
+
+/**
+ * Measures the throughput of samples published one by one or in batches.
+ */
+void benchBatch(const BroadcastMode mode, const size_t batch)
+{
+    const size_t total = 1 << 20;
+    SampleTalker talker(mode);
+    std::vector<SampleListener> listeners(10);
+    for (SampleListener& listener : listeners)
+    {
+        talker.registerTo(&listener);
+    }
+    std::vector<float> samples(batch, 1.0f);
+    Report report("broadcast_batch");
+    int64_t start = monotonicNow();
+    for (size_t published = 0; published < total; published += batch)
+    {
+        int64_t begin = monotonicNow();
+        talker.publish(samples.data(), batch);
+        report.add(monotonicNow() - begin);
+    }
+    report.throughput(static_cast<long>(total), monotonicNow() - start);
+    report.param("mode", toString(mode));
+    report.param("batch", static_cast<long>(batch));
+    report.print();
+}
+
+/**
+ * Listener with a non-virtual update, used by a static talker.
+ */
+class StaticListener
+{
+public:
+    StaticListener() : mSum(0) {}
+
+    inline void update(const Payload<8>& data)
+    {
+        mSum += data.mBytes[0] + data.mBytes[7];
+    }
+
+    uint64_t mSum;
+};
+
+class FourListenersTalker : public StaticTalker<StaticListener, StaticListener, StaticListener, StaticListener>
+{
+public:
+    using StaticTalker::StaticTalker;
+
+    inline void publish(const Payload<8>& data) const
+    {
+        notifyListeners(data);
+    }
+};
+
+/**
+ * Measures broadcasts to four listeners known at compile time and compares them with a generic
+ * talker in the exclusive mode. Broadcasts are timed in blocks, as a single one takes only a few
+ * nanoseconds; every sample is the mean duration of a broadcast within a block.
+ */
+void benchStatic(const long iterations)
+{
+    const long block = 1000;
+    Payload<8> payload;
+    memset(&payload, 1, sizeof(payload));
+    uint64_t sum = 0;
+
+    StaticListener staticListeners[4];
+    FourListenersTalker staticTalker(staticListeners[0], staticListeners[1], staticListeners[2], staticListeners[3]);
+    Report staticReport("broadcast_static");
+    int64_t start = monotonicNow();
+    for (long i = 0; i < iterations; i += block)
+    {
+        int64_t begin = monotonicNow();
+        for (long j = 0; j < block; ++j)
+        {
+            payload.mBytes[0] = static_cast<uint8_t>(j);
+            staticTalker.publish(payload);
+        }
+        staticReport.add((monotonicNow() - begin) / block);
+    }
+    staticReport.throughput(iterations, monotonicNow() - start);
+    for (const StaticListener& listener : staticListeners)
+    {
+        sum += listener.mSum;
+    }
+
+    BenchListener<8> genericListeners[4];
+    BenchTalker<8> genericTalker(BroadcastMode::EXCLUSIVE);
+    for (BenchListener<8>& listener : genericListeners)
+    {
+        genericTalker.registerTo(&listener);
+    }
+    Report genericReport("broadcast_static");
+    start = monotonicNow();
+    for (long i = 0; i < iterations; i += block)
+    {
+        int64_t begin = monotonicNow();
+        for (long j = 0; j < block; ++j)
+        {
+            payload.mBytes[0] = static_cast<uint8_t>(j);
+            genericTalker.publish(payload);
+        }
+        genericReport.add((monotonicNow() - begin) / block);
+    }
+    genericReport.throughput(iterations, monotonicNow() - start);
+    for (const BenchListener<8>& listener : genericListeners)
+    {
+        sum += listener.mSum.load(std::memory_order_relaxed);
+    }
+
+    staticReport.param("talker", "static");
+    genericReport.param("talker", "generic");
+    for (Report* report : {&staticReport, &genericReport})
+    {
+        report->param("listeners", 4L);
+        report->param("checksum", static_cast<long>(sum));
+        report->print();
+    }
+}
+
+/**
+ * Thread that repeatedly takes a lock to increment a shared counter and records the time
+ * it waited for the lock.
+ */
+template<typename Lock>
+class LockUser : public GenericThread<LockUser<Lock>>
+{
+public:
+    LockUser(Lock& lock, uint64_t& counter, const long iterations, const std::atomic<bool>& go)
+    : mLock(lock), mCounter(counter), mIterations(iterations), mGo(go)
+    {
+        mSamples.reserve(iterations);
+    }
+
+    void* threadBody()
+    {
+        while (!mGo.load(std::memory_order_acquire))
+        {
+            sched_yield();
+        }
+        for (long i = 0; i < mIterations; ++i)
+        {
+            int64_t start = monotonicNow();
+            ScopedLock lock(mLock);
+            mSamples.push_back(monotonicNow() - start);
+            ++mCounter;
+        }
+        return nullptr;
+    }
+
+    Lock& mLock;
+    uint64_t& mCounter;
+    const long mIterations;
+    const std::atomic<bool>& mGo;
+    std::vector<int64_t> mSamples;
+};
+
+/**
+ * Measures throughput and acquisition latency of a lock policy shared by a number of threads.
+ */
+template<typename Lock>
+void benchLock(const char* policy, const int threadCount, const long iterations)
+{
+    Lock lock;
+    uint64_t counter = 0;
+    std::atomic<bool> go(false);
+    std::vector<std::unique_ptr<LockUser<Lock>>> threads;
+    for (int i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back(new LockUser<Lock>(lock, counter, iterations, go));
+        threads.back()->startThread();
+    }
+    int64_t start = monotonicNow();
+    go.store(true, std::memory_order_release);
+    for (std::unique_ptr<LockUser<Lock>>& thread : threads)
+    {
+        thread->stopThread();
+    }
+    int64_t elapsed = monotonicNow() - start;
+
+    Report report("lock_contention");
+    for (std::unique_ptr<LockUser<Lock>>& thread : threads)
+    {
+        report.add(thread->mSamples);
+    }
+    report.throughput(iterations * threadCount, elapsed);
+    report.param("policy", policy);
+    report.param("threads", static_cast<long>(threadCount));
+    report.print();
+}
+
+class EmptyThread : public GenericThread<EmptyThread>
+{
+public:
+    void* threadBody()
+    {
+        return nullptr;
+    }
+};
+
+/**
+ * Measures a full startThread and stopThread cycle.
+ */
+void benchThreadCycle(const long cycles)
+{
+    EmptyThread thread;
+    Report report("thread_cycle");
+    int64_t start = monotonicNow();
+    for (long i = 0; i < cycles; ++i)
+    {
+        int64_t begin = monotonicNow();
+        thread.startThread();
+        thread.stopThread();
+        report.add(monotonicNow() - begin);
+    }
+    report.throughput(cycles, monotonicNow() - start);
+    report.print();
+}
+
+template<size_t Size>
+void benchPayload(const BroadcastMode mode)
+{
+    benchBroadcast<Size>("broadcast_payload", mode, 10, 1, 0);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc > 1)
+    {
+        filter = argv[1];
+    }
+
+    for (BroadcastMode mode : {BroadcastMode::EXCLUSIVE, BroadcastMode::SNAPSHOT, BroadcastMode::CONCURRENT})
+    {
+        if (isSelected("broadcast_listeners"))
+        {
+            for (size_t listeners : {1, 10, 100, 1000, 10000})
+            {
+                benchBroadcast<8>("broadcast_listeners", mode, listeners, 1, 0);
+            }
+        }
+        if (isSelected("broadcast_payload"))
+        {
+            benchPayload<8>(mode);
+            benchPayload<256>(mode);
+            benchPayload<4096>(mode);
+            benchPayload<65536>(mode);
+        }
+        if (isSelected("broadcast_publishers"))
+        {
+            for (int publishers : {1, 2, 4, 8})
+            {
+                benchBroadcast<8>("broadcast_publishers", mode, 10, publishers, 0);
+            }
+        }
+        if (isSelected("broadcast_churn"))
+        {
+            for (long rate : {0L, 10L, 100L, 1000L})
+            {
+                benchBroadcast<8>("broadcast_churn", mode, 100, 1, rate);
+            }
+        }
+        if (isSelected("broadcast_batch"))
+        {
+            for (size_t batch : {1, 16, 256})
+            {
+                benchBatch(mode, batch);
+            }
+        }
+        if (isSelected("register"))
+        {
+            for (size_t listeners : {10, 100, 1000, 10000})
+            {
+                benchRegistration(mode, listeners);
+            }
+        }
+    }
+    if (isSelected("lock_contention"))
+    {
+        // the null lock is only correct with a single thread.
+        benchLock<NullLock>("null", 1, 200000);
+        for (int threads : {1, 2, 4, 8})
+        {
+            benchLock<SpinLock>("spin", threads, 200000);
+            benchLock<TicketLock>("ticket", threads, 200000);
+            benchLock<Mutex>("mutex", threads, 200000);
+            benchLock<RecursiveMutex>("recursive_mutex", threads, 200000);
+        }
+    }
+    if (isSelected("broadcast_static"))
+    {
+        benchStatic(10000000);
+    }
+    if (isSelected("thread_cycle"))
+    {
+        benchThreadCycle(2000);
+    }
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <tuple>
+#include <type_traits>
+#include "generic_listener.h"
+#include "generic_thread.h"
+#include "scoped_lock.h"
+#include "spsc_queue.h"
+
+
+/**
+ * A listener that decouples a talker from a slow listener. Updates are copied into a bounded
+ * single-producer/single-consumer queue and delivered to the target listener from a dedicated
+ * worker thread, so the talker only pays for the copy. Register this class to a talker instead
+ * of the target. As the queue has a single producer, updates must not be pushed from more than
+ * one thread at a time. The worker updates the target under its update lock, the one taken by
+ * talkers broadcasting in the concurrent mode, so the target still receives one update at a time.
+ * Lock is the lock of the target and of this listener, see BasicListener.
+ */
+template<typename Lock, typename... Args>
+class BasicAsyncListener : public BasicListener<Lock, Args...>, public GenericThread<BasicAsyncListener<Lock, Args...>>
+{
+    static_assert((std::is_default_constructible<Args>::value && ...), "AsyncListener requires default constructible arguments");
+
+public:
+    /**
+     * Basic constructor that starts the worker thread.
+     *  @param target the listener that will receive updates from the worker thread.
+     *  @param capacity the number of updates that can be queued.
+     *  @param policy the behaviour when the queue is full.
+     */
+    BasicAsyncListener(BasicListener<Lock, Args...>* target, const size_t capacity, const OverflowPolicy policy = OverflowPolicy::BLOCK)
+    : BasicListener<Lock, Args...>(), GenericThread<BasicAsyncListener<Lock, Args...>>(), mTarget(target), mQueue(capacity, policy), mDropTarget(false)
+    {
+        this->startThread();
+    }
+
+    /**
+     * Class destructor that unregisters from all talkers, delivers updates that are still
+     * queued and stops the worker thread.
+     */
+    virtual ~BasicAsyncListener()
+    {
+        this->unregisterAll();
+        this->stopThread();
+    }
+
+    /**
+     * Queues the update for the worker thread.
+     *  @param args a new data broadcasted by a talker.
+     */
+    void update(const Args&... args) override
+    {
+        if (mQueue.push(std::tuple<Args...>(args...)))
+        {
+            this->mEvent.notify();
+        }
+        else
+        {
+            this->countDropped();
+        }
+    }
+
+    /**
+     * Delivers queued updates to the target listener until the class is destroyed.
+     */
+    void* threadBody()
+    {
+        sCurrent = this;
+        while (this->isRunning())
+        {
+            this->mEvent.wait();
+            deliver();
+        }
+        // updates queued before the stop request may have been missed by the last delivery.
+        deliver();
+        return nullptr;
+    }
+
+    /**
+     *  @return the number of updates dropped because the queue was full.
+     */
+    inline size_t getDropped() const
+    {
+        return mQueue.getDropped();
+    }
+
+    /**
+     * Stops delivering to the target: updates still queued and those queued later are discarded.
+     * Once it returns, the target is not updated anymore if it was called from the worker
+     * thread, e.g. by the target from within its update.
+     */
+    inline void dropTarget()
+    {
+        mDropTarget.store(true, std::memory_order_release);
+    }
+
+    /**
+     *  @return true if called from the worker thread of this listener.
+     */
+    inline bool isWorkerThread() const
+    {
+        return this == sCurrent;
+    }
+
+private:
+    /**
+     * Delivers all queued updates to the target listener.
+     */
+    void deliver()
+    {
+        while (mQueue.pop(mData))
+        {
+            ScopedLock lock(mTarget->mUpdateLock);
+            if (!mDropTarget.load(std::memory_order_acquire))
+            {
+                std::apply([this](const Args&... args) { mTarget->update(args...); }, mData);
+            }
+        }
+    }
+
+    /** The listener that receives updates from the worker thread. */
+    BasicListener<Lock, Args...>* mTarget;
+    /** Updates waiting to be delivered. */
+    SpscQueue<std::tuple<Args...>> mQueue;
+    /** Update popped from the queue, kept as a member to reuse its storage. */
+    std::tuple<Args...> mData;
+    /** Flag telling the worker to discard updates instead of delivering them. */
+    std::atomic<bool> mDropTarget;
+    /** The listener whose worker runs on the calling thread, if any. */
+    inline static thread_local const BasicAsyncListener* sCurrent = nullptr;
+};
+
+/**
+ * Asynchronous listener of GenericListener, with the lock selected by LockPolicy.
+ */
+template<typename... Args>
+using AsyncListener = BasicAsyncListener<typename LockPolicy<Args...>::Type, Args...>;
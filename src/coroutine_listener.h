@@ -0,0 +1,445 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine)
+#error "coroutine_listener.h requires C++20, see UTILS_ENABLE_COROUTINES in CMakeLists.txt"
+#endif
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "generic_listener.h"
+#include "generic_thread.h"
+#include "locks.h"
+#include "scoped_lock.h"
+
+class CoroutineExecutor;
+
+/**
+ * The return type of a coroutine run by a CoroutineExecutor. The coroutine does not start when
+ * it is called; it starts once the task is passed to CoroutineExecutor::spawn, and its frame is
+ * freed when it returns. A task that is never spawned frees the coroutine on destruction.
+ */
+class CoroutineTask
+{
+public:
+    /**
+     * The promise of a coroutine returning CoroutineTask.
+     */
+    struct promise_type
+    {
+        CoroutineTask get_return_object()
+        {
+            return CoroutineTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept;
+
+        void return_void()
+        {
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+
+        /** The executor the coroutine was spawned on. */
+        CoroutineExecutor* mExecutor = nullptr;
+    };
+
+    CoroutineTask(CoroutineTask&& other) noexcept : mHandle(std::exchange(other.mHandle, nullptr))
+    {
+    }
+
+    CoroutineTask(const CoroutineTask&) = delete;
+    CoroutineTask& operator=(const CoroutineTask&) = delete;
+
+    /**
+     * Class destructor that frees the coroutine if it was not spawned.
+     */
+    ~CoroutineTask()
+    {
+        if (mHandle)
+        {
+            mHandle.destroy();
+        }
+    }
+
+private:
+    friend class CoroutineExecutor;
+
+    explicit CoroutineTask(const std::coroutine_handle<promise_type> handle) : mHandle(handle)
+    {
+    }
+
+    /** The coroutine, null once it was spawned. */
+    std::coroutine_handle<promise_type> mHandle;
+};
+
+/**
+ * A thread that runs coroutines. Coroutines are resumed one at a time in the order they became
+ * ready, so any number of them share the thread without a context switch between them, and a
+ * few executors can serve hundreds of coroutines. Coroutines that are suspended when the
+ * executor is destroyed are not freed: let them return first, see getActive().
+ */
+class CoroutineExecutor : public GenericThread<CoroutineExecutor>
+{
+public:
+    /**
+     * Basic constructor that starts the thread.
+     */
+    CoroutineExecutor() : GenericThread<CoroutineExecutor>(), mActive(0)
+    {
+        startThread();
+    }
+
+    /**
+     * Class destructor that stops the thread.
+     */
+    virtual ~CoroutineExecutor()
+    {
+        stopThread();
+    }
+
+    /**
+     * Starts a coroutine on this executor.
+     *  @param task the coroutine to start.
+     */
+    void spawn(CoroutineTask&& task)
+    {
+        std::coroutine_handle<CoroutineTask::promise_type> handle = std::exchange(task.mHandle, nullptr);
+        if (handle)
+        {
+            handle.promise().mExecutor = this;
+            mActive.fetch_add(1, std::memory_order_relaxed);
+            schedule(handle);
+        }
+    }
+
+    /**
+     * Queues a suspended coroutine to be resumed by this executor. Can be called from any thread.
+     *  @param handle the coroutine to resume.
+     */
+    void schedule(const std::coroutine_handle<> handle)
+    {
+        bool wasEmpty;
+        {
+            ScopedLock lock(mLock);
+            wasEmpty = mQueue.empty();
+            mQueue.push_back(handle);
+        }
+        if (wasEmpty)
+        {
+            mEvent.notify();
+        }
+    }
+
+    /**
+     *  @return the number of spawned coroutines that have not returned yet.
+     */
+    inline size_t getActive() const
+    {
+        return mActive.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Resumes queued coroutines until the thread is stopped.
+     */
+    void* threadBody()
+    {
+        while (isRunning())
+        {
+            {
+                ScopedLock lock(mLock);
+                mReady.swap(mQueue);
+            }
+            if (mReady.empty())
+            {
+                mEvent.wait();
+                continue;
+            }
+            for (std::coroutine_handle<> handle : mReady)
+            {
+                handle.resume();
+            }
+            mReady.clear();
+        }
+        return nullptr;
+    }
+
+private:
+    friend struct CoroutineTask::promise_type;
+
+    /** Protects the queue. */
+    Mutex mLock;
+    /** Coroutines waiting to be resumed. */
+    std::vector<std::coroutine_handle<>> mQueue;
+    /** Coroutines being resumed, swapped with the queue so that both keep their memory. */
+    std::vector<std::coroutine_handle<>> mReady;
+    /** The number of spawned coroutines that have not returned yet. */
+    std::atomic<size_t> mActive;
+};
+
+inline std::suspend_never CoroutineTask::promise_type::final_suspend() noexcept
+{
+    mExecutor->mActive.fetch_sub(1, std::memory_order_release);
+    return {};
+}
+
+/**
+ * A listener whose updates are consumed by a coroutine with co_await next(), so a stateful
+ * consumer is written as a plain loop instead of a state machine spread over update calls:
+ *
+ *   CoroutineTask consume(CoroutineListener<ImuSample>& imu)
+ *   {
+ *       while (std::optional<ImuSample> sample = co_await imu.next())
+ *       {
+ *           ...
+ *       }
+ *   }
+ *
+ * Updates are copied into a small ring. A coroutine waiting for the next sample is queued on
+ * the executor of the listener, never resumed on the publishing thread, so talkers only pay for
+ * the copy. When the ring is full the oldest sample is dropped. Only one coroutine may await a
+ * listener at a time, and the listener must outlive it: close() the listener and let the
+ * coroutine return before destroying it.
+ * Lock is the lock of the talkers it listens to.
+ */
+template<typename Lock, typename... Args>
+class BasicCoroutineListener : public BasicListener<Lock, Args...>
+{
+    static_assert((std::is_default_constructible<Args>::value && ...), "CoroutineListener requires default constructible arguments");
+
+public:
+    using Sample = typename BasicListener<Lock, Args...>::Sample;
+
+    /**
+     * The result of next(), to be awaited.
+     */
+    class Awaiter
+    {
+    public:
+        explicit Awaiter(BasicCoroutineListener& listener) : mListener(listener)
+        {
+        }
+
+        /**
+         *  @return true if a sample is ready, so the coroutine does not have to suspend.
+         */
+        bool await_ready()
+        {
+            ScopedLock lock(mListener.mLock);
+            return 0 != mListener.mSize || mListener.mClosed;
+        }
+
+        /**
+         * Suspends the coroutine until a sample arrives, unless one arrived meanwhile.
+         *  @param handle the awaiting coroutine.
+         *  @return false to resume the coroutine right away.
+         */
+        bool await_suspend(const std::coroutine_handle<> handle)
+        {
+            ScopedLock lock(mListener.mLock);
+            if (0 != mListener.mSize || mListener.mClosed)
+            {
+                return false;
+            }
+            mListener.mWaiter = handle;
+            return true;
+        }
+
+        /**
+         *  @return the oldest buffered sample, or nothing if the listener was closed and no
+         *          samples are left.
+         */
+        std::optional<Sample> await_resume()
+        {
+            ScopedLock lock(mListener.mLock);
+            if (0 == mListener.mSize)
+            {
+                return std::nullopt;
+            }
+            std::optional<Sample> sample(std::move(mListener.mSamples[mListener.mHead]));
+            mListener.mHead = (mListener.mHead + 1) % mListener.mCapacity;
+            --mListener.mSize;
+            return sample;
+        }
+
+    private:
+        /** The awaited listener. */
+        BasicCoroutineListener& mListener;
+    };
+
+    /**
+     * Basic constructor.
+     *  @param executor the executor that resumes the coroutine awaiting this listener.
+     *  @param capacity the number of samples buffered for the coroutine.
+     */
+    explicit BasicCoroutineListener(CoroutineExecutor& executor, const size_t capacity = 16)
+    : BasicListener<Lock, Args...>(), mExecutor(executor), mCapacity(capacity > 0 ? capacity : 1), mSamples(new Sample[mCapacity]),
+      mHead(0), mSize(0), mDropped(0), mClosed(false)
+    {
+    }
+
+    /**
+     * Class destructor that unregisters from all talkers.
+     */
+    virtual ~BasicCoroutineListener()
+    {
+        this->unregisterAll();
+    }
+
+    /**
+     *  @return an awaitable that yields the next sample, or nothing once the listener was closed
+     *          and all buffered samples were consumed.
+     */
+    inline Awaiter next()
+    {
+        return Awaiter(*this);
+    }
+
+    /**
+     * Buffers the update and queues the waiting coroutine.
+     *  @param args a new data broadcasted by a talker.
+     */
+    void update(const Args&... args) override
+    {
+        std::coroutine_handle<> waiter;
+        {
+            ScopedLock lock(mLock);
+            push(Sample(args...));
+            waiter = std::exchange(mWaiter, nullptr);
+        }
+        if (waiter)
+        {
+            mExecutor.schedule(waiter);
+        }
+    }
+
+    /**
+     * Buffers all samples of a batch and queues the waiting coroutine once.
+     *  @param samples a contiguous array of new data broadcasted by a talker, oldest first.
+     *  @param count the number of samples.
+     */
+    void updateBatch(const Sample* samples, const size_t count) override
+    {
+        std::coroutine_handle<> waiter;
+        {
+            ScopedLock lock(mLock);
+            for (size_t i = 0; i < count; ++i)
+            {
+                push(samples[i]);
+            }
+            waiter = std::exchange(mWaiter, nullptr);
+        }
+        if (waiter)
+        {
+            mExecutor.schedule(waiter);
+        }
+    }
+
+    /**
+     * Unregisters from all talkers and ends the stream: once the buffered samples are consumed,
+     * next() yields nothing.
+     */
+    void close()
+    {
+        this->unregisterAll();
+        std::coroutine_handle<> waiter;
+        {
+            ScopedLock lock(mLock);
+            mClosed = true;
+            waiter = std::exchange(mWaiter, nullptr);
+        }
+        if (waiter)
+        {
+            mExecutor.schedule(waiter);
+        }
+    }
+
+    /**
+     *  @return the number of samples dropped because the ring was full.
+     */
+    size_t getDropped()
+    {
+        ScopedLock lock(mLock);
+        return mDropped;
+    }
+
+private:
+    /**
+     * Appends a sample to the ring, dropping the oldest one if the ring is full. Called under the lock.
+     *  @param sample the sample to append.
+     */
+    void push(const Sample& sample)
+    {
+        if (mSize == mCapacity)
+        {
+            mHead = (mHead + 1) % mCapacity;
+            --mSize;
+            ++mDropped;
+            this->countDropped();
+        }
+        mSamples[(mHead + mSize) % mCapacity] = sample;
+        ++mSize;
+    }
+
+    /** The executor that resumes the waiting coroutine. */
+    CoroutineExecutor& mExecutor;
+    /** The number of samples the ring can hold. */
+    const size_t mCapacity;
+    /** The ring of buffered samples. */
+    std::unique_ptr<Sample[]> mSamples;
+    /** Index of the oldest buffered sample. */
+    size_t mHead;
+    /** The number of buffered samples. */
+    size_t mSize;
+    /** The number of dropped samples. */
+    size_t mDropped;
+    /** True once close() was called. */
+    bool mClosed;
+    /** The coroutine waiting for a sample, if any. */
+    std::coroutine_handle<> mWaiter;
+    /** Protects the ring, the flag and the waiter. */
+    Mutex mLock;
+};
+
+/**
+ * Coroutine listener with the lock selected by LockPolicy.
+ */
+template<typename... Args>
+using CoroutineListener = BasicCoroutineListener<typename LockPolicy<Args...>::Type, Args...>;
@@ -0,0 +1,162 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "locks.h"
+#include "monotonic_clock.h"
+
+
+/**
+ * An auto-reset event for waking up a thread. notify() raises the event and wait() lowers it,
+ * so a notification sent before the thread waits is not lost, and several notifications sent
+ * while the thread is busy coalesce into a single wake-up. A waiting thread first spins for a
+ * short while, which catches quick hand-offs without a context switch, and then parks on a
+ * futex. notify() makes a system call only if some thread is parked.
+ */
+class Event
+{
+public:
+    /**
+     * Basic constructor.
+     *  @param spins the number of checks made before parking, 0 to park right away.
+     */
+    explicit Event(const uint32_t spins = getDefaultSpins()) : mState(0), mWaiters(0), mSpins(spins)
+    {
+    }
+
+    Event(const Event&) = delete;
+    Event& operator=(const Event&) = delete;
+
+    /**
+     * Sets the number of checks made before parking. Must not be called while a thread waits.
+     *  @param spins the number of checks, 0 to park right away.
+     */
+    inline void setSpins(const uint32_t spins)
+    {
+        mSpins = spins;
+    }
+
+    /**
+     * Raises the event and wakes up a waiting thread, if any.
+     */
+    void notify()
+    {
+        if (0 == mState.exchange(1, std::memory_order_seq_cst) && 0 != mWaiters.load(std::memory_order_seq_cst))
+        {
+            futex(FUTEX_WAKE_PRIVATE, 1, nullptr);
+        }
+    }
+
+    /**
+     * Lowers the event if it was raised, without waiting.
+     *  @return true if the event was raised.
+     */
+    inline bool tryWait()
+    {
+        return 0 != mState.load(std::memory_order_relaxed) && 0 != mState.exchange(0, std::memory_order_acquire);
+    }
+
+    /**
+     * Waits until the event is raised and lowers it.
+     */
+    inline void wait()
+    {
+        waitUntil(-1);
+    }
+
+    /**
+     * Waits until the event is raised, for at most @p timeout, and lowers it.
+     *  @param timeout the maximum time to wait in nanoseconds.
+     *  @return false if the timeout expired.
+     */
+    inline bool waitFor(const int64_t timeout)
+    {
+        return waitUntil(monotonicNow() + timeout);
+    }
+
+    /**
+     * Waits until the event is raised or CLOCK_MONOTONIC reaches @p deadline, and lowers it.
+     *  @param deadline monotonic time in nanoseconds, negative to wait without a deadline.
+     *  @return false if the deadline passed.
+     */
+    bool waitUntil(const int64_t deadline)
+    {
+        for (uint32_t i = 0; i < mSpins; ++i)
+        {
+            if (tryWait())
+            {
+                return true;
+            }
+            cpuRelax();
+        }
+
+        timespec ts = {static_cast<time_t>(deadline / NANOSECONDS_PER_SECOND), static_cast<long>(deadline % NANOSECONDS_PER_SECOND)};
+        bool raised = false;
+        // registering as a waiter before the last check pairs with notify() reading the waiters
+        // after raising the event, so either the check sees the event or notify() wakes us up.
+        mWaiters.fetch_add(1, std::memory_order_seq_cst);
+        while (!(raised = (0 != mState.exchange(0, std::memory_order_seq_cst))))
+        {
+            if (0 != futex(FUTEX_WAIT_BITSET_PRIVATE, 0, deadline < 0 ? nullptr : &ts) && ETIMEDOUT == errno)
+            {
+                raised = tryWait();
+                break;
+            }
+        }
+        mWaiters.fetch_sub(1, std::memory_order_relaxed);
+        return raised;
+    }
+
+private:
+    /**
+     *  @return the default number of spins, 0 on a single CPU where spinning cannot help.
+     */
+    static uint32_t getDefaultSpins()
+    {
+        static const uint32_t spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 1000 : 0;
+        return spins;
+    }
+
+    /**
+     * Calls the futex system call on the state of the event. Waits use an absolute
+     * CLOCK_MONOTONIC deadline.
+     */
+    long futex(const int operation, const uint32_t value, const timespec* deadline)
+    {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&mState), operation, value, deadline, nullptr, FUTEX_BITSET_MATCH_ANY);
+    }
+
+    /** 1 if the event is raised, 0 otherwise. It is the futex word. */
+    std::atomic<uint32_t> mState;
+    /** The number of threads parked or about to park on the futex. */
+    std::atomic<uint32_t> mWaiters;
+    /** The number of checks made before parking. */
+    uint32_t mSpins;
+};
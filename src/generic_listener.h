@@ -22,17 +22,39 @@
 
 #pragma once
 
+#include <cstddef>
+#include <tuple>
 #include "registration_base.h"
 
 
-template<typename... Args>
-class GenericTalker;
+template<typename Lock, typename... Args>
+class BasicTalker;
+
+template<typename Lock, typename... Args>
+class BasicAsyncListener;
 
 /**
- * An abstract class implementation of a generic listener interface. 
+ * Defines the type of a single sample in a batch: the argument itself for talkers with
+ * one argument, a tuple of all arguments otherwise.
  */
 template<typename... Args>
-class GenericListener : public RegistrationBase<GenericListener<Args...>, GenericTalker<Args...>>
+struct BatchSample
+{
+    using Type = std::tuple<Args...>;
+};
+
+template<typename Arg>
+struct BatchSample<Arg>
+{
+    using Type = Arg;
+};
+
+/**
+ * An abstract class implementation of a generic listener interface. Lock protects the list of
+ * talkers and serialises concurrent updates; it has to match the lock of the talkers.
+ */
+template<typename Lock, typename... Args>
+class BasicListener : public RegistrationBase<BasicListener<Lock, Args...>, BasicTalker<Lock, Args...>, Lock>
 {
 public:
     /**
@@ -40,4 +62,69 @@ public:
      *  @param args a new data broadcasted by a talker.
      */
     virtual void update(const Args&... args) = 0;
+
+    /** Type of a single sample in a batch. */
+    using Sample = typename BatchSample<Args...>::Type;
+
+    /**
+     * Callback method to receive a number of consecutive updates at once. Listeners that can
+     * process samples in a tight loop should override it; by default update is called for
+     * every sample.
+     *  @param samples a contiguous array of new data broadcasted by a talker, oldest first.
+     *  @param count the number of samples.
+     */
+    virtual void updateBatch(const Sample* samples, const size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            updateSample(samples[i]);
+        }
+    }
+
+protected:
+    /**
+     * Calls update with a single sample of a batch.
+     *  @param sample the sample to pass to update.
+     */
+    inline void updateSample(const Sample& sample)
+    {
+        if constexpr (1 == sizeof...(Args))
+        {
+            update(sample);
+        }
+        else
+        {
+            std::apply([this](const Args&... args) { update(args...); }, sample);
+        }
+    }
+
+    /**
+     * Counts updates dropped by this listener, e.g. because a queue was full. Does nothing
+     * if metrics are compiled out.
+     *  @param count the number of dropped updates.
+     */
+    inline void countDropped(const uint64_t count = 1)
+    {
+#ifdef UTILS_ENABLE_METRICS
+        this->mMetrics.mDropped.fetch_add(count, std::memory_order_relaxed);
+#else
+        (void)count;
+#endif
+    }
+
+private:
+    /** Talkers measure the duration of update calls and take the update lock. */
+    friend class BasicTalker<Lock, Args...>;
+    /** Asynchronous delivery takes the update lock of its target. */
+    friend class BasicAsyncListener<Lock, Args...>;
+
+    /** Serialises updates from talkers broadcasting in the concurrent mode and from AsyncListener,
+     *  but not from exclusive or snapshot talkers. It is held during update. */
+    mutable Lock mUpdateLock;
 };
+
+/**
+ * Listener with the lock selected by LockPolicy, the one used throughout the library.
+ */
+template<typename... Args>
+using GenericListener = BasicListener<typename LockPolicy<Args...>::Type, Args...>;
@@ -22,27 +22,204 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <sched.h>
+#include <type_traits>
+#include <tuple>
+#include <vector>
+#include "async_listener.h"
+#include "listener_routes.h"
+#include "listener_supervision.h"
+#include "rcu_snapshot.h"
 #include "registration_base.h"
 #include "scoped_lock.h"
+#include "thread_pool.h"
 
 
-template<typename... Args>
-class GenericListener;
+template<typename Lock, typename... Args>
+class BasicListener;
+
+/**
+ * Defines how a talker protects its list of listeners during a broadcast, and so how broadcasts
+ * of several publishing threads relate to each other. In every mode, a listener receives updates
+ * published by one thread in the order they were published, also when they are delivered by a
+ * thread pool.
+ */
+enum class BroadcastMode
+{
+    /** The broadcast holds the registration lock for the whole fan-out. Broadcasts never overlap,
+     *  so all listeners receive updates in the same order, one at a time. */
+    EXCLUSIVE,
+    /** The broadcast iterates an immutable snapshot of listeners without taking any lock.
+     *  Registration publishes a new snapshot and waits for broadcasts in progress to finish.
+     *  Broadcasts of different threads run in parallel and may update the same listener at the
+     *  same time, so listeners have to be thread safe. */
+    SNAPSHOT,
+    /** Like SNAPSHOT, but each listener is updated under its own lock, so publishers only wait for
+     *  each other when they reach the same listener. Updates of different threads reach a listener
+     *  in the order their publishers took its lock, which may differ between listeners.
+     *  The lock serialises updates from concurrent talkers and from AsyncListener only: a listener
+     *  that is also registered to an exclusive or snapshot talker still has to be thread safe.
+     *  The lock is held during update, so update must not wait for another thread that may be
+     *  publishing to this listener, and must not publish, directly or through other listeners, to
+     *  a talker that comes back to this listener unless the lock is recursive. Taking the lock
+     *  of a listener and the registration lock of an exclusive talker in opposite orders, e.g. by
+     *  querying that talker from an update while it broadcasts to the same listener, deadlocks. */
+    CONCURRENT
+};
 
 /**
  * Class implementation of a generic talker class. Handy to broadcast data 
  * to multiple listeners that can ad hoc register or unregister.
+ * A listener can also be registered with a subscription, a predicate or a key, which the talker
+ * checks before updating it, and with dispatch options. Listeners are updated in the order of
+ * decreasing priority; among listeners of the same priority, plain listeners go first. Listeners
+ * with a subscription or options are always updated on the publishing thread.
+ * Lock protects the list of listeners, see locks.h; talkers and listeners of one signature
+ * can only be registered with each other if they use the same lock.
  */
-template<typename... Args>
-class GenericTalker : public RegistrationBase<GenericTalker<Args...>, GenericListener<Args...>>
+template<typename Lock, typename... Args>
+class BasicTalker : public RegistrationBase<BasicTalker<Lock, Args...>, BasicListener<Lock, Args...>, Lock>
 {
 public:
+    /** Decides if a listener registered with it receives the given data. */
+    using Predicate = typename ListenerSubscription<Lock, Args...>::Predicate;
+
+    using RegistrationBase<BasicTalker<Lock, Args...>, BasicListener<Lock, Args...>, Lock>::registerTo;
+
     /**
      * Basic constructor that initialises a lock.
+     *  @param mode the way listeners are protected during a broadcast.
+     */
+    explicit BasicTalker(const BroadcastMode mode = BroadcastMode::EXCLUSIVE)
+    : mMode(mode), mListeners(BroadcastMode::EXCLUSIVE != mode ? new RcuSnapshot<Routes>() : nullptr), mPool(nullptr), mWaitForPool(true), mDetachedJobs(0), mJobRunning(false), mRoutesChanged(false), mTalk(true)
+    {
+#ifdef UTILS_ENABLE_METRICS
+        this->mMetrics.setKind(MetricsKind::TALKER);
+#endif
+    }
+
+    /**
+     * Class destructor that waits for broadcasts still running in a thread pool.
+     */
+    virtual ~BasicTalker()
+    {
+        waitForDetachedJobs();
+        // unregistering here rather than in the base class lets itemRemoved retire asynchronous deliveries.
+        this->unregisterAll();
+    }
+
+    /**
+     *  @return the way listeners are protected during a broadcast.
+     */
+    inline BroadcastMode getBroadcastMode() const
+    {
+        return mMode;
+    }
+
+    /**
+     * Enables parallel dispatch: listeners are split into chunks that are updated by the workers
+     * of @p pool. When waiting, the publishing thread updates one chunk itself, helps the pool
+     * with the remaining ones and returns once all listeners were updated; nothing is copied.
+     * Otherwise the data and the list of listeners are copied into a job allocated per broadcast
+     * and notifyListeners returns right after submitting; registration then waits for such
+     * broadcasts to finish. Jobs of a talker run one after another in the order they were
+     * published, so a listener still receives its updates one at a time and in order.
+     * Listeners updated in parallel must be thread safe and, in the exclusive mode, must not
+     * register or unregister on this talker from within their update.
+     *  @param pool the pool to update listeners on, or nullptr to update them on the publishing thread.
+     *  @param wait true to wait until all listeners were updated.
+     */
+    void setThreadPool(ThreadPool* pool, const bool wait = true)
+    {
+        typename BasicTalker::ItemsLock lock(*this);
+        waitForDetachedJobs();
+        mWaitForPool.store(wait, std::memory_order_relaxed);
+        mPool.store(pool, std::memory_order_release);
+    }
+
+    /**
+     * Registers a listener that receives only data accepted by @p predicate. The predicate is
+     * called on the publishing thread, so rejected data costs neither the update call nor the
+     * cache misses of the listener. If the listener is already registered, its subscription is
+     * replaced. The subscription is dropped when the listener is unregistered.
+     *  @param listener the listener to register.
+     *  @param predicate returns true for data the listener should receive; it must be thread safe
+     *         unless the talker broadcasts in the exclusive mode.
+     */
+    void registerTo(BasicListener<Lock, Args...>* listener, const Predicate& predicate)
+    {
+        subscribe(listener, [&predicate](Subscription& subscription) {
+            subscription.mPredicate = predicate;
+            subscription.mKeyed = false;
+        });
+    }
+
+    /**
+     * Registers a listener that receives only data published by notifyListenersByKey with
+     * @p key. Listeners are indexed by their keys, so a broadcast does not visit listeners of
+     * other keys. If the listener is already registered, its subscription is replaced.
+     *  @param listener the listener to register.
+     *  @param key the key of data the listener should receive, e.g. a sensor id.
+     */
+    void registerTo(BasicListener<Lock, Args...>* listener, const uint64_t key)
+    {
+        subscribe(listener, [key](Subscription& subscription) {
+            subscription.mPredicate = Predicate();
+            subscription.mKeyed = true;
+            subscription.mKey = key;
+        });
+    }
+
+    /**
+     * Registers a listener with a priority and an optional time budget. Updates of a listener
+     * with a budget are timed, and a listener that exceeds it mIsolateAfter times in a row is
+     * moved to asynchronous delivery: from then on the publisher only queues its updates and an
+     * AsyncListener thread calls update, so listeners after it keep their latency. That thread
+     * takes the same update lock as the concurrent mode, so the listener still receives one
+     * update at a time. An isolated listener may unregister from within its update; updates
+     * still queued are then discarded. Otherwise unregistering delivers them before returning.
+     * If the listener is already registered, its options are replaced and its subscription kept.
+     *  @param listener the listener to register.
+     *  @param options the priority and budget of the listener.
+     */
+    void registerTo(BasicListener<Lock, Args...>* listener, const DispatchOptions& options)
+    {
+        subscribe(listener, [this, &options](Subscription& subscription) {
+            subscription.mOptions = options;
+            retire(subscription);
+            if (options.mBudget > 0)
+            {
+                subscription.mSupervision = std::make_shared<ListenerSupervision<Lock, Args...>>(options);
+            }
+        });
+    }
+
+    /**
+     *  @param listener a registered listener.
+     *  @return the number of updates of the listener that exceeded its budget.
      */
-    GenericTalker() : mTalk(true)
+    uint64_t getOverruns(BasicListener<Lock, Args...>* listener) const
     {
+        typename BasicTalker::ItemsLock lock(*this);
+        const ListenerSupervision<Lock, Args...>* supervision = findSupervision(listener);
+        return nullptr == supervision ? 0 : supervision->getOverruns();
+    }
+
+    /**
+     *  @param listener a registered listener.
+     *  @return true if the listener was moved to asynchronous delivery.
+     */
+    bool isIsolated(BasicListener<Lock, Args...>* listener) const
+    {
+        typename BasicTalker::ItemsLock lock(*this);
+        const ListenerSupervision<Lock, Args...>* supervision = findSupervision(listener);
+        return nullptr != supervision && supervision->isIsolated();
     }
 
     /**
@@ -71,22 +248,640 @@ public:
 
 protected:
     /**
-     * Notifies all listeners with a new data.
+     * Notifies all listeners with a new data. Listeners registered with a key are not notified.
      *  @param data new data to broadcast to listeners.
      */
-    void notifyListeners(const Args&... data) const
+    inline void notifyListeners(const Args&... data) const
+    {
+        notify(nullptr, data...);
+    }
+
+    /**
+     * Notifies listeners with a new data that belongs to @p key: listeners registered without
+     * a subscription, listeners whose predicate accepts the data and listeners registered with
+     * @p key. Listeners registered with other keys are not visited.
+     *  @param key the key of the data, e.g. a sensor id.
+     *  @param data new data to broadcast to listeners.
+     */
+    inline void notifyListenersByKey(const uint64_t key, const Args&... data) const
+    {
+        notify(&key, data...);
+    }
+
+    /**
+     * Notifies all listeners with a number of consecutive samples at once, paying for the lock
+     * and the virtual call once per listener instead of once per sample. Listeners receive the
+     * samples through updateBatch. Batches are always delivered on the publishing thread,
+     * even if a thread pool was set. Listeners registered with a predicate receive accepted
+     * samples one by one through update, and listeners registered with a key are not notified.
+     *  @param samples a contiguous array of new data to broadcast, oldest first.
+     *  @param count the number of samples.
+     */
+    void notifyListenersBatch(const typename BasicListener<Lock, Args...>::Sample* samples, const size_t count) const
     {
         if (isTalking())
         {
-            ScopedLock lock(this->mLock);
-            for (GenericListener<Args...>* listener : this->mItems)
+            if (BroadcastMode::EXCLUSIVE != mMode)
+            {
+                typename RcuSnapshot<Routes>::ReadGuard routes(*mListeners);
+                routeBatch(*routes, samples, count);
+            }
+            else
+            {
+                typename BasicTalker::ItemsLock lock(*this);
+                const Routes& routes = getExclusiveRoutes();
+                typename BasicTalker::ItemsIteration iteration(*this);
+                routeBatch(routes, samples, count);
+            }
+        }
+#ifdef UTILS_ENABLE_METRICS
+        else
+        {
+            this->mMetrics.mPaused.fetch_add(count, std::memory_order_relaxed);
+        }
+#endif
+    }
+
+    /**
+     * Publishes a new snapshot of listeners when running in the snapshot or concurrent mode.
+     * The previous one is reclaimed once the locks were released. In the exclusive mode,
+     * routes of subscribed listeners are rebuilt by the next broadcast.
+     */
+    void itemsChanged() override
+    {
+        if (BroadcastMode::EXCLUSIVE != mMode)
+        {
+            Routes* routes = new Routes();
+            routes->build(this->items(), mSubscriptions);
+            mListeners->exchange(routes);
+        }
+        else
+        {
+            mRoutesChanged = true;
+        }
+    }
+
+    /**
+     * Drops the subscription of an unregistered listener and stops its asynchronous delivery.
+     * In the exclusive mode, the listener is also taken out of the routes that a broadcast of
+     * this thread may be going through.
+     *  @param item the unregistered listener.
+     */
+    void itemRemoved(BasicListener<Lock, Args...>* item) override
+    {
+        typename Routes::Subscriptions::iterator subscription = mSubscriptions.find(item);
+        if (mSubscriptions.end() != subscription)
+        {
+            retire(subscription->second);
+            mSubscriptions.erase(subscription);
+        }
+        if (BroadcastMode::EXCLUSIVE == mMode && this->isIterating())
+        {
+            mRoutes.clear(item);
+        }
+    }
+
+    /**
+     * Waits for readers of previous snapshots of listeners and for broadcasts submitted to
+     * a thread pool, and stops asynchronous deliveries retired while the locks were held.
+     * None of it is done under the lock, as listeners being updated may wait for it.
+     */
+    void locksReleased() override
+    {
+        if (nullptr != mListeners)
+        {
+            mListeners->reclaim();
+        }
+        if (this != sDetachedTalker)
+        {
+            waitForDetachedJobs();
+        }
+        std::vector<BasicAsyncListener<Lock, Args...>*> retired;
+        {
+            typename BasicTalker::ItemsLock lock(*this);
+            retired.swap(mRetiredDeliveries);
+        }
+        for (BasicAsyncListener<Lock, Args...>* async : retired)
+        {
+            if (async->isWorkerThread())
+            {
+                // the listener unregistered from within its update, so its worker cannot be joined yet.
+                typename BasicTalker::ItemsLock lock(*this);
+                mRetiredDeliveries.push_back(async);
+            }
+            else
             {
-                listener->update(data...);
+                delete async;
             }
         }
     }
 
 private:
+    using Listeners = std::vector<BasicListener<Lock, Args...>*>;
+    using Routes = ListenerRoutes<Lock, Args...>;
+    using Route = typename Routes::Route;
+    using Subscription = ListenerSubscription<Lock, Args...>;
+
+    /**
+     * Registers a listener with a subscription, or changes the subscription of a registered one.
+     *  @param listener the listener to register.
+     *  @param change the change of the subscription.
+     */
+    template<typename Change>
+    void subscribe(BasicListener<Lock, Args...>* listener, const Change& change)
+    {
+        {
+            typename BasicTalker::ItemsLock lock(*this);
+            // the subscription is changed first, so that the routes built on registration include it.
+            change(mSubscriptions[listener]);
+            if (!this->registerLocked(listener))
+            {
+                itemsChanged();
+            }
+        }
+        locksReleased();
+    }
+
+    /**
+     * Detaches the asynchronous delivery of a listener, if any, and prevents the listener from
+     * being isolated again. The lock has to be held. The delivery is stopped by locksReleased,
+     * as its worker may need the locks to finish an update; if the listener unregisters from
+     * within an update made by the worker, updates still queued are discarded instead.
+     *  @param subscription the subscription of the listener.
+     */
+    void retire(Subscription& subscription)
+    {
+        if (nullptr != subscription.mSupervision)
+        {
+            BasicAsyncListener<Lock, Args...>* async = subscription.mSupervision->retire();
+            if (nullptr != async)
+            {
+                if (async->isWorkerThread())
+                {
+                    async->dropTarget();
+                }
+                mRetiredDeliveries.push_back(async);
+            }
+            subscription.mSupervision.reset();
+        }
+    }
+
+    /**
+     * Finds the state of the budget of a listener. The lock has to be held.
+     *  @param listener a registered listener.
+     *  @return the state, nullptr if the listener has no budget.
+     */
+    const ListenerSupervision<Lock, Args...>* findSupervision(BasicListener<Lock, Args...>* listener) const
+    {
+        typename Routes::Subscriptions::const_iterator subscription = mSubscriptions.find(listener);
+        return mSubscriptions.end() == subscription ? nullptr : subscription->second.mSupervision.get();
+    }
+
+    /**
+     * Brings the routes of the exclusive mode up to date. The lock has to be held. While routes
+     * are being iterated by an outer broadcast, they are not rebuilt, and listeners that
+     * registered in the meantime are reached from the next broadcast.
+     *  @return the routes.
+     */
+    const Routes& getExclusiveRoutes() const
+    {
+        if (mRoutesChanged && !this->isIterating())
+        {
+            mRoutes = Routes();
+            mRoutes.build(this->items(), mSubscriptions);
+            mRoutesChanged = false;
+        }
+        return mRoutes;
+    }
+
+    /**
+     * Notifies listeners with a new data, optionally with a key.
+     *  @param key the key of the data, nullptr if it has none.
+     *  @param data new data to broadcast to listeners.
+     */
+    void notify(const uint64_t* key, const Args&... data) const
+    {
+        if (isTalking())
+        {
+            if (BroadcastMode::EXCLUSIVE != mMode)
+            {
+                typename RcuSnapshot<Routes>::ReadGuard routes(*mListeners);
+                route(*routes, key, data...);
+            }
+            else
+            {
+                typename BasicTalker::ItemsLock lock(*this);
+                if (mSubscriptions.empty())
+                {
+                    // without subscriptions the list of items is broadcast to as it is.
+                    typename BasicTalker::ItemsIteration iteration(*this);
+                    countBroadcast(0 != this->itemCount());
+                    broadcast(this->items(), data...);
+                }
+                else
+                {
+                    const Routes& routes = getExclusiveRoutes();
+                    typename BasicTalker::ItemsIteration iteration(*this);
+                    route(routes, key, data...);
+                }
+            }
+        }
+#ifdef UTILS_ENABLE_METRICS
+        else
+        {
+            this->mMetrics.mPaused.fetch_add(1, std::memory_order_relaxed);
+        }
+#endif
+    }
+
+    /**
+     * Updates listeners that should receive a new data: first routed listeners with a positive
+     * priority, then plain listeners, then the remaining routed listeners.
+     *  @param routes the listeners grouped by their subscriptions.
+     *  @param key the key of the data, nullptr if it has none.
+     *  @param data new data to broadcast to listeners.
+     */
+    void route(const Routes& routes, const uint64_t* key, const Args&... data) const
+    {
+        const std::vector<Route>& keyed = routes.findKeyed(key);
+        countBroadcast(!routes.mListeners.empty() || !routes.mRoutes.empty() || !keyed.empty());
+
+        size_t next = 0;
+        size_t nextKeyed = 0;
+        const auto update = [this, &data...](const Route& route) {
+            if (!route.mPredicate || route.mPredicate(data...))
+            {
+                BasicListener<Lock, Args...>* listener = route.mListener;
+                supervise(route, [listener, &data...] { listener->update(data...); },
+                          [&data...](BasicAsyncListener<Lock, Args...>* async) { async->update(data...); });
+            }
+        };
+        Routes::merge(routes.mRoutes, next, keyed, nextKeyed, true, update);
+        broadcast(routes.mListeners, data...);
+        Routes::merge(routes.mRoutes, next, keyed, nextKeyed, false, update);
+    }
+
+    /**
+     * Updates listeners with a batch of samples in the same order as route. Listeners with
+     * a predicate receive accepted samples one by one, and keyed listeners are skipped.
+     *  @param routes the listeners grouped by their subscriptions.
+     *  @param samples a contiguous array of new data to broadcast.
+     *  @param count the number of samples.
+     */
+    void routeBatch(const Routes& routes, const typename BasicListener<Lock, Args...>::Sample* samples, const size_t count) const
+    {
+        const std::vector<Route>& none = routes.findKeyed(nullptr);
+        countBroadcast(!routes.mListeners.empty() || !routes.mRoutes.empty(), count);
+
+        size_t next = 0;
+        size_t nextKeyed = 0;
+        const auto update = [this, samples, count](const Route& route) {
+            BasicListener<Lock, Args...>* listener = route.mListener;
+            if (!route.mPredicate)
+            {
+                supervise(route, [listener, samples, count] { listener->updateBatch(samples, count); },
+                          [samples, count](BasicAsyncListener<Lock, Args...>* async) { async->updateBatch(samples, count); });
+                return;
+            }
+            for (size_t i = 0; i < count; ++i)
+            {
+                const typename BasicListener<Lock, Args...>::Sample& sample = samples[i];
+                bool accepted = false;
+                if constexpr (1 == sizeof...(Args))
+                {
+                    accepted = route.mPredicate(sample);
+                }
+                else
+                {
+                    accepted = std::apply(route.mPredicate, sample);
+                }
+                if (accepted)
+                {
+                    supervise(route, [listener, &sample] { listener->updateSample(sample); },
+                              [&sample](BasicAsyncListener<Lock, Args...>* async) { async->updateBatch(&sample, 1); });
+                }
+            }
+        };
+        Routes::merge(routes.mRoutes, next, none, nextKeyed, true, update);
+        broadcastBatch(routes.mListeners, samples, count);
+        Routes::merge(routes.mRoutes, next, none, nextKeyed, false, update);
+    }
+
+    /**
+     * Updates a routed listener. A listener with a budget is timed under its update lock and
+     * the duration is reported to its supervision; once it is isolated, its updates are only
+     * queued for its asynchronous delivery.
+     *  @param route the listener and its budget.
+     *  @param update the call to make on the listener.
+     *  @param queue the call to make on the asynchronous delivery of an isolated listener.
+     */
+    template<typename Update, typename Queue>
+    void supervise(const Route& route, const Update& update, const Queue& queue) const
+    {
+        BasicListener<Lock, Args...>* listener = route.mListener;
+        ListenerSupervision<Lock, Args...>* supervision = route.mSupervision.get();
+        if (nullptr == supervision)
+        {
+            deliver(listener, update);
+        }
+        else if (!supervision->queue(queue))
+        {
+            ScopedLock lock(listener->mUpdateLock);
+            const int64_t start = monotonicNow();
+            measure(listener, update);
+            supervision->record(listener, monotonicNow() - start);
+        }
+    }
+
+    /**
+     * A broadcast split into chunks, processed while the publisher waits. It refers to the
+     * listeners and data of the publisher instead of copying them.
+     */
+    struct WaitingJob
+    {
+        const BasicTalker* mTalker;
+        const Listeners& mListeners;
+        std::tuple<const Args&...> mData;
+        size_t mChunks;
+        std::atomic<size_t> mRemaining;
+
+        void finish()
+        {
+            mRemaining.fetch_sub(1, std::memory_order_release);
+        }
+    };
+
+    /**
+     * A broadcast split into chunks that owns copies of the listeners and data. The last chunk
+     * to finish starts the next job of the talker, if any, and deletes the job.
+     */
+    struct DetachedJob
+    {
+        const BasicTalker* mTalker;
+        ThreadPool* mPool;
+        Listeners mListeners;
+        std::tuple<Args...> mData;
+        size_t mChunks;
+        std::atomic<size_t> mRemaining;
+
+        void submit()
+        {
+            for (size_t i = 0; i < mChunks; ++i)
+            {
+                mPool->submit({&BasicTalker::runChunk<DetachedJob>, this, i});
+            }
+        }
+
+        void finish()
+        {
+            if (1 == mRemaining.fetch_sub(1, std::memory_order_acq_rel))
+            {
+                DetachedJob* next = mTalker->nextDetachedJob();
+                mTalker->mDetachedJobs.fetch_sub(1, std::memory_order_release);
+                delete this;
+                if (nullptr != next)
+                {
+                    next->submit();
+                }
+            }
+        }
+    };
+
+    /**
+     * Takes the next detached job waiting for the running one to finish.
+     *  @return the next job, nullptr if there is none, in which case no job is running anymore.
+     */
+    DetachedJob* nextDetachedJob() const
+    {
+        ScopedLock lock(mDetachedLock);
+        if (mQueuedJobs.empty())
+        {
+            mJobRunning = false;
+            return nullptr;
+        }
+        DetachedJob* next = mQueuedJobs.front();
+        mQueuedJobs.pop_front();
+        return next;
+    }
+
+    /**
+     * Updates listeners, in parallel if a thread pool was set.
+     *  @param listeners the listeners to update.
+     *  @param data new data to broadcast to listeners.
+     */
+    void broadcast(const Listeners& listeners, const Args&... data) const
+    {
+        ThreadPool* pool = mPool.load(std::memory_order_acquire);
+        if (nullptr == pool || listeners.size() < 2 || 0 == pool->getWorkerCount())
+        {
+            // the list may grow from within an update in the exclusive mode, so it is read by index.
+            for (size_t i = 0; i < listeners.size(); ++i)
+            {
+                BasicListener<Lock, Args...>* listener = listeners[i];
+                if (nullptr != listener)
+                {
+                    deliver(listener, [listener, &data...] { listener->update(data...); });
+                }
+            }
+        }
+        else if (mWaitForPool.load(std::memory_order_relaxed))
+        {
+            size_t chunks = std::min(listeners.size(), pool->getWorkerCount() + 1);
+            WaitingJob job{this, listeners, std::tuple<const Args&...>(data...), chunks, {chunks}};
+            for (size_t i = 1; i < chunks; ++i)
+            {
+                pool->submit({&BasicTalker::runChunk<WaitingJob>, &job, i});
+            }
+            runChunk<WaitingJob>(&job, 0);
+            while (0 != job.mRemaining.load(std::memory_order_acquire))
+            {
+                if (!pool->runPending())
+                {
+                    sched_yield();
+                }
+            }
+        }
+        else
+        {
+            size_t chunks = std::min(listeners.size(), pool->getWorkerCount());
+            mDetachedJobs.fetch_add(1, std::memory_order_acq_rel);
+            DetachedJob* job = new DetachedJob{this, pool, listeners, std::tuple<Args...>(data...), chunks, {chunks}};
+            {
+                // a listener is in a single chunk of a job, so running one job at a time keeps its updates serial and ordered.
+                ScopedLock lock(mDetachedLock);
+                if (mJobRunning)
+                {
+                    mQueuedJobs.push_back(job);
+                    job = nullptr;
+                }
+                mJobRunning = true;
+            }
+            if (nullptr != job)
+            {
+                job->submit();
+            }
+        }
+    }
+
+    /**
+     * Makes a single call of update or updateBatch on a listener, under the lock of the listener
+     * in the concurrent mode.
+     *  @param listener the listener to update.
+     *  @param update the call to make.
+     */
+    template<typename Update>
+    inline void deliver(BasicListener<Lock, Args...>* listener, const Update& update) const
+    {
+        if (BroadcastMode::CONCURRENT == mMode)
+        {
+            ScopedLock lock(listener->mUpdateLock);
+            measure(listener, update);
+        }
+        else
+        {
+            measure(listener, update);
+        }
+    }
+
+    /**
+     * Makes a call on a listener and, with metrics enabled, records its duration.
+     *  @param listener the listener to update.
+     *  @param update the call to make.
+     */
+    template<typename Update>
+    static inline void measure(BasicListener<Lock, Args...>* listener, const Update& update)
+    {
+#ifdef UTILS_ENABLE_METRICS
+        const int64_t start = monotonicNow();
+        update();
+        listener->mMetrics.mUpdateTime.record(monotonicNow() - start);
+#else
+        (void)listener;
+        update();
+#endif
+    }
+
+    /**
+     * Updates all listeners with a batch of samples on the calling thread.
+     *  @param listeners the listeners to update.
+     *  @param samples a contiguous array of new data to broadcast.
+     *  @param count the number of samples.
+     */
+    void broadcastBatch(const Listeners& listeners, const typename BasicListener<Lock, Args...>::Sample* samples, const size_t count) const
+    {
+        for (BasicListener<Lock, Args...>* listener : listeners)
+        {
+            if (nullptr != listener)
+            {
+                deliver(listener, [listener, samples, count] { listener->updateBatch(samples, count); });
+            }
+        }
+    }
+
+    /**
+     * Counts broadcasts, and dropped ones if they reach no listener. Does nothing if metrics
+     * are compiled out.
+     *  @param reached false if the broadcast goes to no listener.
+     *  @param count the number of samples broadcasted.
+     */
+    inline void countBroadcast(const bool reached, const uint64_t count = 1) const
+    {
+#ifdef UTILS_ENABLE_METRICS
+        this->mMetrics.mPublished.fetch_add(count, std::memory_order_relaxed);
+        if (!reached)
+        {
+            this->mMetrics.mDropped.fetch_add(count, std::memory_order_relaxed);
+        }
+#else
+        (void)reached;
+        (void)count;
+#endif
+    }
+
+    /**
+     * Updates one chunk of listeners of a parallel broadcast.
+     *  @param context the job.
+     *  @param index the index of the chunk.
+     */
+    template<typename Job>
+    static void runChunk(void* context, size_t index)
+    {
+        Job* job = static_cast<Job*>(context);
+        const BasicTalker* previous = sDetachedTalker;
+        sDetachedTalker = std::is_same<Job, DetachedJob>::value ? job->mTalker : nullptr;
+        {
+            // a worker takes part in the read-side section of the publisher, so that a listener
+            // unregistering from within its update does not wait for the broadcast to finish.
+            std::optional<typename RcuSnapshot<Routes>::ReadGuard> guard;
+            if (nullptr != job->mTalker->mListeners)
+            {
+                guard.emplace(*job->mTalker->mListeners);
+            }
+            const size_t size = job->mListeners.size();
+            const size_t end = (index + 1) * size / job->mChunks;
+            for (size_t i = index * size / job->mChunks; i < end; ++i)
+            {
+                BasicListener<Lock, Args...>* listener = job->mListeners[i];
+                if (nullptr != listener)
+                {
+                    job->mTalker->deliver(listener, [listener, job] {
+                        std::apply([listener](const Args&... data) { listener->update(data...); }, job->mData);
+                    });
+                }
+            }
+        }
+        sDetachedTalker = previous;
+        job->finish();
+    }
+
+    /**
+     * Waits until all broadcasts submitted without waiting have finished, helping the pool.
+     */
+    void waitForDetachedJobs() const
+    {
+        while (0 != mDetachedJobs.load(std::memory_order_acquire))
+        {
+            ThreadPool* pool = mPool.load(std::memory_order_acquire);
+            if (nullptr == pool || !pool->runPending())
+            {
+                sched_yield();
+            }
+        }
+    }
+
+    /** The way listeners are protected during a broadcast. */
+    const BroadcastMode mMode;
+    /** Immutable copy of registered listeners grouped by subscriptions, used by the snapshot and concurrent modes.
+     *  It is not allocated in the exclusive mode. */
+    const std::unique_ptr<RcuSnapshot<Routes>> mListeners;
+    /** Thread pool used to update listeners in parallel, nullptr to update them on the publishing thread. */
+    std::atomic<ThreadPool*> mPool;
+    /** Flag indicating if parallel broadcasts wait for all listeners to be updated. */
+    std::atomic<bool> mWaitForPool;
+    /** The number of parallel broadcasts that were not waited for and are still running. */
+    mutable std::atomic<int> mDetachedJobs;
+    /** Protects the queue of detached jobs. */
+    mutable Mutex mDetachedLock;
+    /** Detached jobs waiting for the running one to finish. */
+    mutable std::deque<DetachedJob*> mQueuedJobs;
+    /** Flag indicating that a detached job is running. */
+    mutable bool mJobRunning;
+    /** The talker whose detached broadcast is being processed by the calling thread. */
+    inline static thread_local const BasicTalker* sDetachedTalker = nullptr;
+    /** Asynchronous deliveries of unregistered listeners, stopped once the locks are released. */
+    std::vector<BasicAsyncListener<Lock, Args...>*> mRetiredDeliveries;
+    /** Subscriptions of listeners registered with a predicate or a key. */
+    typename Routes::Subscriptions mSubscriptions;
+    /** Listeners grouped by subscriptions, used by the exclusive mode while there are subscriptions. */
+    mutable Routes mRoutes;
+    /** Flag indicating that mRoutes has to be rebuilt before the next broadcast. */
+    mutable bool mRoutesChanged;
     /** Flag indicating if the talker is should broadcast updates or not. */
     std::atomic<bool> mTalk;
 };
+
+/**
+ * Talker with the lock selected by LockPolicy, the one used throughout the library.
+ */
+template<typename... Args>
+using GenericTalker = BasicTalker<typename LockPolicy<Args...>::Type, Args...>;
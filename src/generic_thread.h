@@ -24,7 +24,8 @@
 
 #include <atomic>
 #include <pthread.h>
-#include <semaphore.h>
+#include "event.h"
+#include "thread_config.h"
 
 template <typename Derived>
 class GenericThread
@@ -33,10 +34,9 @@ public:
     /**
      * Basic class constructor.
      */
-    GenericThread() : mThread(0)
+    GenericThread() : mThread(0), mConfig(nullptr), mConfigured(nullptr)
     {
         pthread_mutex_init(&mMutex, nullptr);
-        sem_init(&mSemaphore, 0, 0);
         mRun.store(false, std::memory_order_release);
     }
 
@@ -46,7 +46,6 @@ public:
     virtual ~GenericThread()
     {
         stopThread(false);
-        sem_destroy(&mSemaphore);
         pthread_mutex_destroy(&mMutex);
     }
 
@@ -55,19 +54,64 @@ public:
      */
     bool startThread()
     {
+        // the flag has to be raised before the thread starts, otherwise threadBody may see it still cleared.
+        mRun.store(true, std::memory_order_release);
         bool retVal = (0 == pthread_create(&mThread, nullptr, GenericThread::startThread, static_cast<Derived*>(this)));
         mRun.store(retVal, std::memory_order_release);
         return retVal;
     }
 
     /**
-     * Stops the thread and returns any data it may have created.
+     * Starts the thread with given settings. The settings are applied by the new thread to itself
+     * before threadBody is called, and this function returns once they were applied. A setting
+     * that cannot be applied does not prevent the thread from starting; check getConfigStatus().
+     *  @param config the settings of the thread.
+     *  @return true if the thread was started.
+     */
+    bool startThread(const ThreadConfig& config)
+    {
+        pthread_attr_t attr;
+        Event configured;
+        pthread_attr_init(&attr);
+        mConfigStatus = ThreadConfigStatus();
+        if (config.mStackSize > 0)
+        {
+            mConfigStatus.mStackSize = pthread_attr_setstacksize(&attr, config.mStackSize);
+        }
+        mConfig = &config;
+        mConfigured = &configured;
+
+        mRun.store(true, std::memory_order_release);
+        bool retVal = (0 == pthread_create(&mThread, &attr, GenericThread::startConfiguredThread, static_cast<Derived*>(this)));
+        mRun.store(retVal, std::memory_order_release);
+        if (retVal)
+        {
+            configured.wait();
+        }
+
+        mConfig = nullptr;
+        mConfigured = nullptr;
+        pthread_attr_destroy(&attr);
+        return retVal;
+    }
+
+    /**
+     *  @return errors of settings that could not be applied by the last startThread(const ThreadConfig&).
+     */
+    inline const ThreadConfigStatus& getConfigStatus() const
+    {
+        return mConfigStatus;
+    }
+
+    /**
+     * Stops the thread and returns any data it may have created. A thread waiting on mEvent
+     * is woken up, so it can see that it should stop without polling isRunning().
      *  @param force a flag to indicate if the termination should be forced by cancelling the thread.
      *  @param[out] threadReturn data returned by the thread. nullptr assumes no return data.
      */
     void stopThread(const bool force = false, void* threadReturn = nullptr)
     {
-        mRun.store(false, std::memory_order_release);
+        requestStop();
         if (mThread > 0)
         {
             if (force)
@@ -79,6 +123,20 @@ public:
         }
     }
 
+    /**
+     * Tells the thread to stop without waiting for it: isRunning() returns false from now on
+     * and mEvent is raised. A thread that sleeps on something else, e.g. a socket, has to be
+     * woken up after this call and before stopThread joins it.
+     */
+    void requestStop()
+    {
+        mRun.store(false, std::memory_order_release);
+        if (mThread > 0)
+        {
+            mEvent.notify();
+        }
+    }
+
     /**
      *  @return true if the thread is running.
      */
@@ -90,8 +148,8 @@ public:
 protected:
     /** Mutex for locking resources. */
     pthread_mutex_t mMutex;
-    /** Semaphore for thread synchronisation. */
-    sem_t mSemaphore;
+    /** Event for waking up the thread, raised also when the thread is being stopped. */
+    Event mEvent;
 
 private:
     /**
@@ -104,8 +162,28 @@ private:
         return static_cast<Derived*>(instance)->threadBody();
     }
 
+    /**
+     * Applies the thread settings, lets startThread know about it and runs threadBody.
+     *  @param instance an instance of the derived class.
+     *  @return thread return values.
+     */
+    static void* startConfiguredThread(void* instance)
+    {
+        Derived* derived = static_cast<Derived*>(instance);
+        GenericThread* thread = derived;
+        applyThreadConfig(*thread->mConfig, thread->mConfigStatus);
+        thread->mConfigured->notify();
+        return derived->threadBody();
+    }
+
     /** Pthread related to this class. */
     pthread_t mThread;
     /** A flag indicating if the thread is running. */
     std::atomic<bool> mRun;
+    /** Settings applied by a thread being started, valid only during startThread. */
+    const ThreadConfig* mConfig;
+    /** Event raised once the settings were applied, valid only during startThread. */
+    Event* mConfigured;
+    /** Errors of settings that could not be applied. */
+    ThreadConfigStatus mConfigStatus;
 };
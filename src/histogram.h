@@ -0,0 +1,179 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+/**
+ * Histogram of non-negative values, typically durations in nanoseconds, with power of two
+ * buckets: bucket 0 counts zeros and bucket i counts values in [2^(i-1), 2^i). Recording is
+ * lock-free and can be done from any thread while others read the histogram.
+ */
+class Histogram
+{
+public:
+    /** The number of buckets. */
+    static constexpr int BUCKETS = 65;
+
+    /**
+     * Basic constructor that creates an empty histogram.
+     */
+    Histogram()
+    {
+        reset();
+    }
+
+    /**
+     * Copy constructor. Each value of @p other is read once, so values recorded meanwhile
+     * may be only partially included in the copy.
+     *  @param other the histogram to copy.
+     */
+    Histogram(const Histogram& other)
+    {
+        *this = other;
+    }
+
+    /**
+     * Copies values of another histogram, see the copy constructor.
+     *  @param other the histogram to copy.
+     *  @return reference to this histogram.
+     */
+    Histogram& operator=(const Histogram& other)
+    {
+        for (int i = 0; i < BUCKETS; ++i)
+        {
+            mBuckets[i].store(other.getBucket(i), std::memory_order_relaxed);
+        }
+        mCount.store(other.getCount(), std::memory_order_relaxed);
+        mSum.store(other.mSum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        mMax.store(other.getMax(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    /**
+     * Adds a value to the histogram.
+     *  @param value the value to add, negative values are counted as zero.
+     */
+    void record(const int64_t value)
+    {
+        uint64_t sample = value > 0 ? static_cast<uint64_t>(value) : 0;
+        mBuckets[0 == sample ? 0 : 64 - __builtin_clzll(sample)].fetch_add(1, std::memory_order_relaxed);
+        mCount.fetch_add(1, std::memory_order_relaxed);
+        mSum.fetch_add(sample, std::memory_order_relaxed);
+        uint64_t max = mMax.load(std::memory_order_relaxed);
+        while (sample > max && !mMax.compare_exchange_weak(max, sample, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /**
+     * Removes all values from the histogram.
+     */
+    void reset()
+    {
+        for (std::atomic<uint64_t>& bucket : mBuckets)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        mCount.store(0, std::memory_order_relaxed);
+        mSum.store(0, std::memory_order_relaxed);
+        mMax.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return the number of recorded values.
+     */
+    inline uint64_t getCount() const
+    {
+        return mCount.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @param index the index of a bucket, from 0 to BUCKETS - 1.
+     *  @return the number of values recorded in the bucket.
+     */
+    inline uint64_t getBucket(const int index) const
+    {
+        return mBuckets[index].load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @param index the index of a bucket, from 0 to BUCKETS - 1.
+     *  @return the exclusive upper bound of values counted in the bucket.
+     */
+    static inline uint64_t getUpperBound(const int index)
+    {
+        return index >= 64 ? UINT64_MAX : (static_cast<uint64_t>(1) << index);
+    }
+
+    /**
+     *  @return the highest recorded value.
+     */
+    inline uint64_t getMax() const
+    {
+        return mMax.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return the mean of recorded values, or zero if the histogram is empty.
+     */
+    double getMean() const
+    {
+        uint64_t count = getCount();
+        return 0 == count ? 0.0 : static_cast<double>(mSum.load(std::memory_order_relaxed)) / static_cast<double>(count);
+    }
+
+    /**
+     * Estimates a percentile as the upper bound of the bucket it falls into.
+     *  @param fraction the percentile as a fraction, e.g. 0.99.
+     *  @return the estimated percentile, never higher than the maximum.
+     */
+    uint64_t getPercentile(const double fraction) const
+    {
+        uint64_t count = getCount();
+        uint64_t rank = static_cast<uint64_t>(fraction * static_cast<double>(count));
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i)
+        {
+            seen += getBucket(i);
+            if (seen > rank)
+            {
+                uint64_t bound = getUpperBound(i) - 1;
+                return bound < getMax() ? bound : getMax();
+            }
+        }
+        return getMax();
+    }
+
+private:
+    /** Number of values in each bucket. */
+    std::atomic<uint64_t> mBuckets[BUCKETS];
+    /** Number of recorded values. */
+    std::atomic<uint64_t> mCount;
+    /** Sum of recorded values. */
+    std::atomic<uint64_t> mSum;
+    /** Highest recorded value. */
+    std::atomic<uint64_t> mMax;
+};
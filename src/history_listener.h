@@ -0,0 +1,341 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include "generic_listener.h"
+#include "monotonic_clock.h"
+#include "ring_utils.h"
+
+
+/**
+ * A listener that keeps the last updates with their timestamps, so that any number of threads
+ * can look up the value at a given time or the two samples around it for interpolation. Samples
+ * are stored in a fixed-size ring in which each slot is a small seqlock: the talker writes
+ * wait-free, readers binary-search the ring by timestamp without locking and retry only if the
+ * writer overwrites a slot they are reading. The storage is made of relaxed atomic words, so
+ * concurrent reads and writes never race on plain memory. Only trivially copyable arguments are
+ * supported, updates must come from one publishing thread at a time and timestamps must not
+ * decrease.
+ * Lock has to match the lock of the talkers the listener registers to.
+ */
+template<typename Lock, typename... Args>
+class BasicHistoryListener : public BasicListener<Lock, Args...>
+{
+    static_assert((std::is_trivially_copyable<Args>::value && ...), "HistoryListener requires trivially copyable arguments");
+
+public:
+    /** Returns the timestamp of an update in nanoseconds. */
+    using Timestamp = int64_t (*)(const Args&...);
+
+    /**
+     * A timestamped sample read from the history.
+     */
+    struct Record
+    {
+        /** The timestamp of the sample in nanoseconds. */
+        int64_t mTimestamp;
+        /** The arguments of the update. */
+        typename BasicListener<Lock, Args...>::Sample mSample;
+    };
+
+    /**
+     * Basic constructor.
+     *  @param capacity the number of samples to keep, rounded up to a power of two.
+     *  @param timestamp returns the timestamp of an update, nullptr to use the monotonic time
+     *         of its arrival (monotonicNow()).
+     */
+    explicit BasicHistoryListener(const size_t capacity, const Timestamp timestamp = nullptr)
+    : BasicListener<Lock, Args...>(), mCapacity(roundUpToPowerOfTwo(capacity)), mSlots(new std::atomic<uint64_t>[mCapacity * STRIDE]),
+      mTimestamp(timestamp), mCount(0)
+    {
+        for (size_t i = 0; i < mCapacity * STRIDE; ++i)
+        {
+            mSlots[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Adds the update to the history.
+     *  @param args a new data broadcasted by a talker.
+     */
+    void update(const Args&... args) override
+    {
+        uint64_t count = mCount.load(std::memory_order_relaxed);
+        store(count, nullptr == mTimestamp ? monotonicNow() : mTimestamp(args...), args...);
+        mCount.store(count + 1, std::memory_order_release);
+    }
+
+    /**
+     * Adds all samples of a batch to the history and publishes them at once.
+     *  @param samples a contiguous array of new data broadcasted by a talker, oldest first.
+     *  @param count the number of samples.
+     */
+    void updateBatch(const typename BasicListener<Lock, Args...>::Sample* samples, const size_t count) override
+    {
+        uint64_t first = mCount.load(std::memory_order_relaxed);
+        int64_t arrival = nullptr == mTimestamp ? monotonicNow() : 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if constexpr (1 == sizeof...(Args))
+            {
+                store(first + i, nullptr == mTimestamp ? arrival : mTimestamp(samples[i]), samples[i]);
+            }
+            else
+            {
+                std::apply([this, first, i, arrival](const Args&... args)
+                           { store(first + i, nullptr == mTimestamp ? arrival : mTimestamp(args...), args...); }, samples[i]);
+            }
+        }
+        mCount.store(first + count, std::memory_order_release);
+    }
+
+    /**
+     * Copies the most recent sample.
+     *  @param[out] record the sample, left untouched if the history is empty.
+     *  @return false if the history is empty.
+     */
+    bool latest(Record& record) const
+    {
+        uint64_t end;
+        do
+        {
+            end = mCount.load(std::memory_order_acquire);
+            if (0 == end)
+            {
+                return false;
+            }
+        }
+        while (!read(end - 1, record));
+        return true;
+    }
+
+    /**
+     * Finds the value at a given time, that is the latest sample not newer than @p time.
+     *  @param time the time to look up in nanoseconds.
+     *  @param[out] record the sample, left untouched if there is none.
+     *  @return false if all samples in the history are newer than @p time.
+     */
+    bool find(const int64_t time, Record& record) const
+    {
+        for (;;)
+        {
+            uint64_t begin;
+            uint64_t index;
+            uint64_t end;
+            if (!search(time, begin, index, end))
+            {
+                continue;
+            }
+            if (index == begin)
+            {
+                return false;
+            }
+            if (read(index - 1, record))
+            {
+                return true;
+            }
+        }
+    }
+
+    /**
+     * Finds the two samples around a given time, to interpolate between them. If a sample has
+     * exactly the given timestamp, both records are copies of it.
+     *  @param time the time to look up in nanoseconds.
+     *  @param[out] before the latest sample not newer than @p time.
+     *  @param[out] after the earliest sample not older than @p time.
+     *  @return false if @p time is outside of the history.
+     */
+    bool findAround(const int64_t time, Record& before, Record& after) const
+    {
+        for (;;)
+        {
+            uint64_t begin;
+            uint64_t index;
+            uint64_t end;
+            if (!search(time, begin, index, end))
+            {
+                continue;
+            }
+            if (index == begin)
+            {
+                return false;
+            }
+            if (!read(index - 1, before))
+            {
+                continue;
+            }
+            if (before.mTimestamp == time)
+            {
+                after = before;
+                return true;
+            }
+            if (index == end)
+            {
+                return false;
+            }
+            if (read(index, after))
+            {
+                return true;
+            }
+        }
+    }
+
+    /**
+     *  @return the number of samples received so far, including those no longer in the history.
+     */
+    inline uint64_t getCount() const
+    {
+        return mCount.load(std::memory_order_acquire);
+    }
+
+    /**
+     *  @return the number of samples the history keeps.
+     */
+    inline size_t getCapacity() const
+    {
+        return mCapacity;
+    }
+
+private:
+    /**
+     * Finds the first sample newer than @p time with binary search.
+     *  @param time the time to look up in nanoseconds.
+     *  @param[out] begin the index of the oldest sample in the history.
+     *  @param[out] index the index of the first sample newer than @p time, @p end if there is none.
+     *  @param[out] end the index one past the latest sample.
+     *  @return false if a slot was overwritten during the search, which has to be repeated.
+     */
+    bool search(const int64_t time, uint64_t& begin, uint64_t& index, uint64_t& end) const
+    {
+        end = mCount.load(std::memory_order_acquire);
+        begin = end > mCapacity ? end - mCapacity : 0;
+        index = begin;
+        uint64_t last = end;
+        int64_t stamp;
+        while (index < last)
+        {
+            uint64_t middle = index + (last - index) / 2;
+            if (!readTimestamp(middle, stamp))
+            {
+                return false;
+            }
+            if (stamp <= time)
+            {
+                index = middle + 1;
+            }
+            else
+            {
+                last = middle;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Writes a sample into its slot without publishing it.
+     *  @param index the index of the sample.
+     *  @param stamp the timestamp of the sample.
+     *  @param args the arguments to store.
+     */
+    void store(const uint64_t index, const int64_t stamp, const Args&... args)
+    {
+        uint64_t buffer[1 + WORDS];
+        buffer[0] = static_cast<uint64_t>(stamp);
+        SeqlockWords<Args...>::pack(buffer + 1, args...);
+        std::atomic<uint64_t>* slot = &mSlots[(index & (mCapacity - 1)) * STRIDE];
+        seqlockWrite(slot[0], 2 * index + 1, 2 * index + 2, slot + 1, buffer, 1 + WORDS);
+    }
+
+    /**
+     * Reads the timestamp of a sample.
+     *  @param index the index of the sample.
+     *  @param[out] stamp the timestamp.
+     *  @return false if the sample was overwritten.
+     */
+    bool readTimestamp(const uint64_t index, int64_t& stamp) const
+    {
+        const std::atomic<uint64_t>* slot = &mSlots[(index & (mCapacity - 1)) * STRIDE];
+        uint64_t value;
+        uint64_t version;
+        if (!seqlockRead(slot[0], slot + 1, &value, 1, version) || 2 * index + 2 != version)
+        {
+            return false;
+        }
+        stamp = static_cast<int64_t>(value);
+        return true;
+    }
+
+    /**
+     * Reads a sample.
+     *  @param index the index of the sample.
+     *  @param[out] record the sample, may be partially written if false is returned.
+     *  @return false if the sample was overwritten.
+     */
+    bool read(const uint64_t index, Record& record) const
+    {
+        const std::atomic<uint64_t>* slot = &mSlots[(index & (mCapacity - 1)) * STRIDE];
+        uint64_t buffer[1 + WORDS];
+        uint64_t version;
+        if (!seqlockRead(slot[0], slot + 1, buffer, 1 + WORDS, version) || 2 * index + 2 != version)
+        {
+            return false;
+        }
+
+        record.mTimestamp = static_cast<int64_t>(buffer[0]);
+        if constexpr (1 == sizeof...(Args))
+        {
+            SeqlockWords<Args...>::unpack(buffer + 1, record.mSample);
+        }
+        else
+        {
+            std::apply([&buffer](Args&... args) { SeqlockWords<Args...>::unpack(buffer + 1, args...); }, record.mSample);
+        }
+        return true;
+    }
+
+    /** The number of words needed to store all arguments one after another. */
+    static constexpr size_t WORDS = SeqlockWords<Args...>::COUNT;
+    /** The number of words of a slot: the sequence number, the timestamp and the arguments. */
+    static constexpr size_t STRIDE = 2 + WORDS;
+
+    /** The number of slots. */
+    const size_t mCapacity;
+    /** Slots, each one an odd sequence number while written, 2 * (index + 1) once written. */
+    std::unique_ptr<std::atomic<uint64_t>[]> mSlots;
+    /** Returns the timestamp of an update, nullptr to use the time of arrival. */
+    const Timestamp mTimestamp;
+    /** The number of published samples. */
+    alignas(64) std::atomic<uint64_t> mCount;
+};
+
+/**
+ * History listener with the lock selected by LockPolicy.
+ */
+template<typename... Args>
+using HistoryListener = BasicHistoryListener<typename LockPolicy<Args...>::Type, Args...>;
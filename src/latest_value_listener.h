@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <sched.h>
+#include <tuple>
+#include <type_traits>
+#include "generic_listener.h"
+#include "ring_utils.h"
+
+
+/**
+ * A listener that only keeps the most recent update. The arguments are stored in a seqlock:
+ * the talker writes them wait-free and any number of threads can poll the latest value without
+ * locking; a reader that overlaps with a write simply retries. The storage is made of relaxed
+ * atomic words, so concurrent reads and writes never race on plain memory. Only trivially
+ * copyable arguments are supported, and updates must come from one publishing thread at a time.
+ * Lock is the lock of the talkers the listener registers to, see BasicListener.
+ */
+template<typename Lock, typename... Args>
+class BasicLatestValueListener : public BasicListener<Lock, Args...>
+{
+    static_assert((std::is_trivially_copyable<Args>::value && ...), "LatestValueListener requires trivially copyable arguments");
+
+public:
+    /**
+     * Basic constructor.
+     */
+    BasicLatestValueListener() : BasicListener<Lock, Args...>(), mSequence(0)
+    {
+        for (std::atomic<uint64_t>& word : mWords)
+        {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Stores the update as the latest value.
+     *  @param args a new data broadcasted by a talker.
+     */
+    void update(const Args&... args) override
+    {
+        store(1, args...);
+    }
+
+    /**
+     * Stores only the last sample of a batch, but counts all of them in getVersion().
+     *  @param samples a contiguous array of new data broadcasted by a talker, oldest first.
+     *  @param count the number of samples.
+     */
+    void updateBatch(const typename BasicListener<Lock, Args...>::Sample* samples, const size_t count) override
+    {
+        if (count > 0)
+        {
+            if constexpr (1 == sizeof...(Args))
+            {
+                store(count, samples[count - 1]);
+            }
+            else
+            {
+                std::apply([this, count](const Args&... args) { store(count, args...); }, samples[count - 1]);
+            }
+        }
+    }
+
+    /**
+     * Copies the latest value.
+     *  @param[out] args the most recent data broadcasted by a talker.
+     *  @return false if no update was received yet, in which case @p args are left untouched.
+     */
+    bool latest(Args&... args) const
+    {
+        uint64_t buffer[WORDS];
+        uint64_t version;
+        while (!seqlockRead(mSequence, mWords, buffer, WORDS, version))
+        {
+            sched_yield();
+        }
+        if (0 == version)
+        {
+            return false;
+        }
+        SeqlockWords<Args...>::unpack(buffer, args...);
+        return true;
+    }
+
+    /**
+     *  @return the number of updates received so far. Can be used to poll for a new value cheaply.
+     */
+    inline uint64_t getVersion() const
+    {
+        return mSequence.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    /**
+     * Writes arguments into the seqlock.
+     *  @param updates the number of updates the write stands for.
+     *  @param args the arguments to store.
+     */
+    void store(const uint64_t updates, const Args&... args)
+    {
+        uint64_t buffer[WORDS];
+        SeqlockWords<Args...>::pack(buffer, args...);
+        uint64_t sequence = mSequence.load(std::memory_order_relaxed);
+        seqlockWrite(mSequence, sequence + 1, sequence + 2 * updates, mWords, buffer, WORDS);
+    }
+
+    /** The number of words needed to store all arguments one after another. */
+    static constexpr size_t WORDS = SeqlockWords<Args...>::COUNT;
+
+    /** Sequence number, odd while a write is in progress. */
+    alignas(64) std::atomic<uint64_t> mSequence;
+    /** The latest arguments packed into words. */
+    std::atomic<uint64_t> mWords[WORDS];
+};
+
+/**
+ * Latest value listener with the lock selected by LockPolicy.
+ */
+template<typename... Args>
+using LatestValueListener = BasicLatestValueListener<typename LockPolicy<Args...>::Type, Args...>;
@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "generic_listener.h"
+#include "listener_supervision.h"
+
+
+/**
+ * The subscription and options of a listener registered to a talker with a predicate, a key or
+ * options.
+ */
+template<typename Lock, typename... Args>
+struct ListenerSubscription
+{
+    /** Decides if the listener receives the given data. */
+    using Predicate = std::function<bool(const Args&...)>;
+
+    /** The predicate, empty to accept all data. */
+    Predicate mPredicate;
+    /** True if the subscription is keyed. */
+    bool mKeyed = false;
+    /** The key of a keyed subscription. */
+    uint64_t mKey = 0;
+    /** The priority and the budget. */
+    DispatchOptions mOptions;
+    /** The state of the budget, nullptr if the listener has no budget. */
+    std::shared_ptr<ListenerSupervision<Lock, Args...>> mSupervision;
+};
+
+/**
+ * A listener registered with a subscription or options, as seen by broadcasts.
+ */
+template<typename Lock, typename... Args>
+struct ListenerRoute
+{
+    BasicListener<Lock, Args...>* mListener;
+    int mPriority;
+    /** Copy of the predicate, empty to accept all data. */
+    typename ListenerSubscription<Lock, Args...>::Predicate mPredicate;
+    /** The state of the budget, nullptr if the listener has no budget. */
+    std::shared_ptr<ListenerSupervision<Lock, Args...>> mSupervision;
+};
+
+/**
+ * Listeners of a talker grouped by the way they receive broadcasts: plain listeners receive
+ * all of them, routed ones are sorted by decreasing priority and keyed ones are indexed by
+ * their keys, so that a broadcast does not visit listeners of other keys.
+ */
+template<typename Lock, typename... Args>
+struct ListenerRoutes
+{
+    using Route = ListenerRoute<Lock, Args...>;
+    using Subscriptions = std::unordered_map<BasicListener<Lock, Args...>*, ListenerSubscription<Lock, Args...>>;
+
+    /**
+     * Groups registered listeners by their subscriptions and sorts them by priority.
+     *  @param listeners the registered listeners, possibly with nullptr in place of removed ones.
+     *  @param subscriptions the subscriptions of listeners that have one.
+     */
+    void build(const std::vector<BasicListener<Lock, Args...>*>& listeners, const Subscriptions& subscriptions)
+    {
+        for (BasicListener<Lock, Args...>* listener : listeners)
+        {
+            if (nullptr == listener)
+            {
+                continue;
+            }
+            typename Subscriptions::const_iterator found = subscriptions.find(listener);
+            if (subscriptions.end() == found)
+            {
+                mListeners.push_back(listener);
+                continue;
+            }
+            const ListenerSubscription<Lock, Args...>& subscription = found->second;
+            Route route{listener, subscription.mOptions.mPriority, subscription.mPredicate, subscription.mSupervision};
+            if (subscription.mKeyed)
+            {
+                mKeyed[subscription.mKey].push_back(std::move(route));
+            }
+            else if (!subscription.mPredicate && 0 == subscription.mOptions.mPriority && nullptr == subscription.mSupervision)
+            {
+                // default options of a listener make it a plain one.
+                mListeners.push_back(listener);
+            }
+            else
+            {
+                mRoutes.push_back(std::move(route));
+            }
+        }
+        const auto higher = [](const Route& first, const Route& second) { return first.mPriority > second.mPriority; };
+        std::stable_sort(mRoutes.begin(), mRoutes.end(), higher);
+        for (std::pair<const uint64_t, std::vector<Route>>& keyed : mKeyed)
+        {
+            std::stable_sort(keyed.second.begin(), keyed.second.end(), higher);
+        }
+    }
+
+    /**
+     * Takes a listener out of all groups without moving the others, so that a broadcast going
+     * through them can carry on.
+     *  @param listener the listener to take out.
+     */
+    void clear(BasicListener<Lock, Args...>* listener)
+    {
+        std::replace(mListeners.begin(), mListeners.end(), listener, static_cast<BasicListener<Lock, Args...>*>(nullptr));
+        clear(mRoutes, listener);
+        for (std::pair<const uint64_t, std::vector<Route>>& keyed : mKeyed)
+        {
+            clear(keyed.second, listener);
+        }
+    }
+
+    /**
+     *  @param key the key of the data, nullptr if it has none.
+     *  @return the routes of listeners registered with @p key, empty if there are none.
+     */
+    const std::vector<Route>& findKeyed(const uint64_t* key) const
+    {
+        static const std::vector<Route> NONE;
+        if (nullptr == key || mKeyed.empty())
+        {
+            return NONE;
+        }
+        typename std::unordered_map<uint64_t, std::vector<Route>>::const_iterator found = mKeyed.find(*key);
+        return mKeyed.end() == found ? NONE : found->second;
+    }
+
+    /**
+     * Calls @p update on two lists of routes sorted by decreasing priority, merging them so that
+     * the order of priorities is kept. Routes of unregistered listeners are skipped.
+     *  @param first the first list.
+     *  @param[in,out] next the index of the next route of the first list.
+     *  @param second the second list.
+     *  @param[in,out] nextSecond the index of the next route of the second list.
+     *  @param positive true to stop at the first route with a priority that is not positive.
+     *  @param update the call to make for each route.
+     */
+    template<typename Update>
+    static void merge(const std::vector<Route>& first, size_t& next, const std::vector<Route>& second, size_t& nextSecond,
+                      const bool positive, const Update& update)
+    {
+        while (next < first.size() || nextSecond < second.size())
+        {
+            const bool fromFirst = nextSecond >= second.size() || (next < first.size() && first[next].mPriority >= second[nextSecond].mPriority);
+            const Route& route = fromFirst ? first[next] : second[nextSecond];
+            if (positive && route.mPriority <= 0)
+            {
+                break;
+            }
+            if (nullptr != route.mListener)
+            {
+                update(route);
+            }
+            ++(fromFirst ? next : nextSecond);
+        }
+    }
+
+    /** Listeners without a subscription or options, they receive all broadcasts. */
+    std::vector<BasicListener<Lock, Args...>*> mListeners;
+    /** Listeners with a predicate or options, by decreasing priority. */
+    std::vector<Route> mRoutes;
+    /** Listeners registered with a key, by their keys and then by decreasing priority. */
+    std::unordered_map<uint64_t, std::vector<Route>> mKeyed;
+
+private:
+    /**
+     * Takes a listener out of routes without moving the others.
+     *  @param routes the routes to update.
+     *  @param listener the listener to take out.
+     */
+    static void clear(std::vector<Route>& routes, BasicListener<Lock, Args...>* listener)
+    {
+        for (Route& route : routes)
+        {
+            if (listener == route.mListener)
+            {
+                route.mListener = nullptr;
+            }
+        }
+    }
+};
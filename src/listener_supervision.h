@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "async_listener.h"
+#include "locks.h"
+#include "scoped_lock.h"
+#include "spsc_queue.h"
+
+
+/**
+ * Settings of the dispatch to a single listener, see GenericTalker::registerTo.
+ */
+struct DispatchOptions
+{
+    /** Listeners with a higher priority are updated first. */
+    int mPriority = 0;
+    /** The time budget of a single update in nanoseconds, 0 for no budget. */
+    int64_t mBudget = 0;
+    /** The number of consecutive updates over budget after which the listener is moved to
+     *  asynchronous delivery, 0 to never move it. */
+    uint32_t mIsolateAfter = 0;
+    /** The capacity of the queue of asynchronous delivery. */
+    size_t mQueueCapacity = 1024;
+    /** The behaviour of asynchronous delivery when the queue is full. BLOCK is treated as
+     *  DROP_OLDEST, as a publisher must not wait for a listener isolated for being slow. */
+    OverflowPolicy mOverflowPolicy = OverflowPolicy::DROP_OLDEST;
+};
+
+/**
+ * Time budget of a listener registered to a talker with DispatchOptions, and its state. It is
+ * shared by all copies of the routes of the talker. The talker times updates of the listener
+ * and reports them here; once the listener exceeds its budget too many times in a row, it is
+ * isolated: an AsyncListener is created for it and its updates are only queued from then on.
+ */
+template<typename Lock, typename... Args>
+class ListenerSupervision
+{
+public:
+    /**
+     * Basic constructor.
+     *  @param options the budget and the isolation settings.
+     */
+    explicit ListenerSupervision(const DispatchOptions& options)
+    : mOptions(options), mConsecutive(0), mOverruns(0), mAsync(nullptr), mRetired(false)
+    {
+    }
+
+    /**
+     * Class destructor that stops the asynchronous delivery, if any.
+     */
+    ~ListenerSupervision()
+    {
+        delete mAsync.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return the time budget of a single update in nanoseconds.
+     */
+    inline int64_t getBudget() const
+    {
+        return mOptions.mBudget;
+    }
+
+    /**
+     *  @return the number of updates over budget.
+     */
+    inline uint64_t getOverruns() const
+    {
+        return mOverruns.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return true if the listener was moved to asynchronous delivery.
+     */
+    inline bool isIsolated() const
+    {
+        return nullptr != mAsync.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Queues an update for the asynchronous delivery of an isolated listener. The queue is
+     * pushed to without the update lock of the listener, which the worker takes for each update.
+     *  @param queue the call to make on the asynchronous delivery.
+     *  @return true if the listener is isolated and the update was queued.
+     */
+    template<typename Queue>
+    bool queue(const Queue& queue)
+    {
+        if (!isIsolated())
+        {
+            return false;
+        }
+        ScopedLock lock(mLock);
+        BasicAsyncListener<Lock, Args...>* async = mAsync.load(std::memory_order_relaxed);
+        if (nullptr == async)
+        {
+            return false;
+        }
+        queue(async);
+        return true;
+    }
+
+    /**
+     * Accounts for the duration of an update, isolating the listener once it exceeded the budget
+     * too many times in a row. The update lock of the listener has to be held.
+     *  @param listener the listener that was updated.
+     *  @param duration the duration of the update in nanoseconds.
+     */
+    void record(BasicListener<Lock, Args...>* listener, const int64_t duration)
+    {
+        if (duration <= mOptions.mBudget)
+        {
+            mConsecutive = 0;
+            return;
+        }
+        mOverruns.fetch_add(1, std::memory_order_relaxed);
+        if (++mConsecutive >= mOptions.mIsolateAfter && mOptions.mIsolateAfter > 0)
+        {
+            ScopedLock lock(mLock);
+            if (!mRetired && nullptr == mAsync.load(std::memory_order_relaxed))
+            {
+                const OverflowPolicy policy = OverflowPolicy::BLOCK == mOptions.mOverflowPolicy ? OverflowPolicy::DROP_OLDEST : mOptions.mOverflowPolicy;
+                mAsync.store(new BasicAsyncListener<Lock, Args...>(listener, mOptions.mQueueCapacity, policy), std::memory_order_release);
+            }
+        }
+    }
+
+    /**
+     * Detaches the asynchronous delivery, if any, and prevents the listener from being isolated
+     * again. Called once the listener is unregistered or its options are replaced.
+     *  @return the asynchronous delivery that the caller has to stop, nullptr if there is none.
+     */
+    BasicAsyncListener<Lock, Args...>* retire()
+    {
+        ScopedLock lock(mLock);
+        mRetired = true;
+        return mAsync.exchange(nullptr, std::memory_order_acq_rel);
+    }
+
+private:
+    /** Makes the asynchronous delivery single-producer and guards its creation and retirement. */
+    Mutex mLock;
+    /** The budget and the isolation settings. */
+    const DispatchOptions mOptions;
+    /** The number of consecutive updates over budget. */
+    uint32_t mConsecutive;
+    /** The number of updates over budget. */
+    std::atomic<uint64_t> mOverruns;
+    /** Asynchronous delivery of an isolated listener, nullptr until it is isolated. */
+    std::atomic<BasicAsyncListener<Lock, Args...>*> mAsync;
+    /** Raised when the listener is unregistered, so that it is not isolated anymore. */
+    bool mRetired;
+};
@@ -0,0 +1,239 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <pthread.h>
+#include <sched.h>
+
+
+/**
+ * Lock policies for RegistrationBase and ScopedLock. Each policy provides lock(), tryLock() and
+ * unlock(). Only RecursiveMutex can be locked again by the thread that already holds it.
+ */
+
+/**
+ * Tells the CPU that the thread is spinning, so it can save power and yield to a sibling
+ * hyper-thread.
+ */
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+/**
+ * A lock that does nothing, for objects used by a single thread only.
+ */
+class NullLock
+{
+public:
+    inline void lock() {}
+    inline bool tryLock() { return true; }
+    inline void unlock() {}
+};
+
+/**
+ * Test-and-test-and-set spinlock. While the lock is taken, a waiting thread only reads it and
+ * backs off exponentially, and yields the CPU once the back-off reaches its limit. Suited to very
+ * short critical sections on threads that are not preempted while holding the lock.
+ */
+class SpinLock
+{
+public:
+    SpinLock() : mLocked(false) {}
+
+    SpinLock(const SpinLock&) = delete;
+    SpinLock& operator=(const SpinLock&) = delete;
+
+    void lock()
+    {
+        uint32_t backoff = 1;
+        while (mLocked.exchange(true, std::memory_order_acquire))
+        {
+            while (mLocked.load(std::memory_order_relaxed))
+            {
+                if (backoff > MAX_BACKOFF)
+                {
+                    sched_yield();
+                    continue;
+                }
+                for (uint32_t i = 0; i < backoff; ++i)
+                {
+                    cpuRelax();
+                }
+                backoff <<= 1;
+            }
+        }
+    }
+
+    inline bool tryLock()
+    {
+        return !mLocked.load(std::memory_order_relaxed) && !mLocked.exchange(true, std::memory_order_acquire);
+    }
+
+    inline void unlock()
+    {
+        mLocked.store(false, std::memory_order_release);
+    }
+
+private:
+    /** The number of pauses after which a waiting thread starts yielding. */
+    static constexpr uint32_t MAX_BACKOFF = 1024;
+
+    /** True while the lock is held. */
+    std::atomic<bool> mLocked;
+};
+
+/**
+ * Ticket spinlock. Threads are served in the order they arrived, so none of them starves under
+ * contention. A waiting thread backs off in proportion to its distance from the head of the queue
+ * and yields the CPU if its turn does not come soon. As the lock is handed over in a fixed order,
+ * every hand-off needs a context switch when there are more contending threads than CPUs, so it
+ * only pays off when each contending thread has a CPU of its own.
+ */
+class TicketLock
+{
+public:
+    TicketLock() : mNext(0), mServing(0) {}
+
+    TicketLock(const TicketLock&) = delete;
+    TicketLock& operator=(const TicketLock&) = delete;
+
+    void lock()
+    {
+        const uint32_t ticket = mNext.fetch_add(1, std::memory_order_relaxed);
+        uint32_t serving;
+        uint32_t rounds = 0;
+        while (ticket != (serving = mServing.load(std::memory_order_acquire)))
+        {
+            // the holder, or a thread served earlier, may have been preempted.
+            const uint32_t distance = ticket - serving;
+            if (distance > MAX_DISTANCE || ++rounds > MAX_ROUNDS)
+            {
+                sched_yield();
+                continue;
+            }
+            for (uint32_t i = 0; i < distance * BACKOFF; ++i)
+            {
+                cpuRelax();
+            }
+        }
+    }
+
+    inline bool tryLock()
+    {
+        uint32_t ticket = mServing.load(std::memory_order_relaxed);
+        return mNext.compare_exchange_strong(ticket, ticket + 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    inline void unlock()
+    {
+        mServing.store(mServing.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    /** Pauses per thread waiting ahead. */
+    static constexpr uint32_t BACKOFF = 32;
+    /** The number of threads waiting ahead above which a thread yields instead of spinning. */
+    static constexpr uint32_t MAX_DISTANCE = 8;
+    /** The number of back-off rounds after which a thread yields instead of spinning. */
+    static constexpr uint32_t MAX_ROUNDS = 4;
+
+    /** The next ticket to hand out. */
+    alignas(64) std::atomic<uint32_t> mNext;
+    /** The ticket allowed to hold the lock. */
+    alignas(64) std::atomic<uint32_t> mServing;
+};
+
+/**
+ * A plain pthread mutex.
+ */
+class Mutex
+{
+public:
+    Mutex()
+    {
+        pthread_mutex_init(&mMutex, nullptr);
+    }
+
+    ~Mutex()
+    {
+        pthread_mutex_destroy(&mMutex);
+    }
+
+    Mutex(const Mutex&) = delete;
+    Mutex& operator=(const Mutex&) = delete;
+
+    inline void lock() { pthread_mutex_lock(&mMutex); }
+    inline bool tryLock() { return 0 == pthread_mutex_trylock(&mMutex); }
+    inline void unlock() { pthread_mutex_unlock(&mMutex); }
+
+protected:
+    /**
+     * Constructor for mutexes of a given type.
+     *  @param type the type of the mutex, e.g. PTHREAD_MUTEX_RECURSIVE.
+     */
+    explicit Mutex(const int type)
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, type);
+        pthread_mutex_init(&mMutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+
+private:
+    /** The mutex. */
+    pthread_mutex_t mMutex;
+};
+
+/**
+ * A pthread mutex that can be locked again by the thread that holds it.
+ */
+class RecursiveMutex : public Mutex
+{
+public:
+    RecursiveMutex() : Mutex(PTHREAD_MUTEX_RECURSIVE) {}
+};
+
+/**
+ * Selects the default lock of GenericTalker<Args...> and GenericListener<Args...>. To change the
+ * synchronisation cost of a talker and its listeners, give the lock to them directly, e.g.
+ *   class ImuTalker : public BasicTalker<SpinLock, ImuSample> { ... };
+ *   class ImuListener : public BasicListener<SpinLock, ImuSample> { ... };
+ * Specialising this trait instead changes the lock of every talker and listener of a signature,
+ * so the specialisation has to be visible in every translation unit that uses the signature.
+ * Locks other than RecursiveMutex do not allow a listener updated in the exclusive mode to
+ * register or unregister on the talker that is updating it.
+ */
+template<typename... Args>
+struct LockPolicy
+{
+    using Type = RecursiveMutex;
+};
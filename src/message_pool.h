@@ -0,0 +1,272 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+
+template<typename T>
+class MessagePool;
+
+/**
+ * Reference counted handle to a message owned by a MessagePool. Copying the handle only
+ * increments the reference count, so a listener can keep a broadcast message past its update
+ * without copying the payload. The slot goes back to the pool when the last handle is dropped.
+ * Publish handles with GenericTalker<MessageHandle<T>>; listeners should treat the message
+ * as read-only once it has been broadcasted.
+ */
+template<typename T>
+class MessageHandle
+{
+public:
+    /**
+     * Creates an empty handle.
+     */
+    MessageHandle() : mSlot(nullptr)
+    {
+    }
+
+    MessageHandle(const MessageHandle& other) : mSlot(other.mSlot)
+    {
+        if (nullptr != mSlot)
+        {
+            mSlot->mReferences.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    MessageHandle(MessageHandle&& other) noexcept : mSlot(other.mSlot)
+    {
+        other.mSlot = nullptr;
+    }
+
+    MessageHandle& operator=(const MessageHandle& other)
+    {
+        MessageHandle(other).swap(*this);
+        return *this;
+    }
+
+    MessageHandle& operator=(MessageHandle&& other) noexcept
+    {
+        MessageHandle(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    /**
+     * Class destructor that returns the message to the pool if this was the last handle.
+     */
+    ~MessageHandle()
+    {
+        reset();
+    }
+
+    /**
+     * Drops the reference to the message.
+     */
+    void reset()
+    {
+        if (nullptr != mSlot && 1 == mSlot->mReferences.fetch_sub(1, std::memory_order_acq_rel))
+        {
+            mSlot->mPool->release(mSlot);
+        }
+        mSlot = nullptr;
+    }
+
+    void swap(MessageHandle& other) noexcept
+    {
+        std::swap(mSlot, other.mSlot);
+    }
+
+    /**
+     *  @return the number of handles referring to the message.
+     */
+    inline unsigned int getReferenceCount() const
+    {
+        return nullptr != mSlot ? mSlot->mReferences.load(std::memory_order_relaxed) : 0;
+    }
+
+    inline T* get() const
+    {
+        return nullptr != mSlot ? &mSlot->mValue : nullptr;
+    }
+
+    inline T& operator*() const
+    {
+        return mSlot->mValue;
+    }
+
+    inline T* operator->() const
+    {
+        return &mSlot->mValue;
+    }
+
+    /**
+     *  @return true if the handle refers to a message.
+     */
+    inline explicit operator bool() const
+    {
+        return nullptr != mSlot;
+    }
+
+private:
+    friend class MessagePool<T>;
+
+    using Slot = typename MessagePool<T>::Slot;
+
+    /**
+     * Creates a handle to a freshly acquired slot.
+     *  @param slot the slot with its reference count already set to one.
+     */
+    explicit MessageHandle(Slot* slot) : mSlot(slot)
+    {
+    }
+
+    /** The slot holding the message. */
+    Slot* mSlot;
+};
+
+/**
+ * Fixed-size pool of preallocated messages. Acquiring and releasing a message does not allocate
+ * and is lock-free, which makes it usable from a publishing thread. Messages are constructed once
+ * with the pool and reused as they are, so large buffers keep their capacity between broadcasts
+ * and the publisher is expected to overwrite the content. The pool must outlive all its handles.
+ */
+template<typename T>
+class MessagePool
+{
+public:
+    /**
+     * Basic constructor that preallocates all messages.
+     *  @param size the number of messages in the pool.
+     */
+    explicit MessagePool(const uint32_t size) : mSize(size), mSlots(new Slot[size]), mFree(pack(0, 0 < size ? 0 : NONE)), mAvailable(size)
+    {
+        for (uint32_t i = 0; i < mSize; ++i)
+        {
+            mSlots[i].mPool = this;
+            mSlots[i].mNext.store(i + 1 < mSize ? i + 1 : NONE, std::memory_order_relaxed);
+        }
+    }
+
+    MessagePool(const MessagePool&) = delete;
+    MessagePool& operator=(const MessagePool&) = delete;
+
+    /**
+     * Takes a message from the pool.
+     *  @return handle to the message, or an empty handle if all messages are in use.
+     */
+    MessageHandle<T> acquire()
+    {
+        uint64_t head = mFree.load(std::memory_order_acquire);
+        uint32_t index;
+        do
+        {
+            index = static_cast<uint32_t>(head);
+            if (NONE == index)
+            {
+                return MessageHandle<T>();
+            }
+        }
+        while (!mFree.compare_exchange_weak(head, pack(tag(head) + 1, mSlots[index].mNext.load(std::memory_order_relaxed)),
+                                            std::memory_order_acq_rel, std::memory_order_acquire));
+
+        mAvailable.fetch_sub(1, std::memory_order_relaxed);
+        mSlots[index].mReferences.store(1, std::memory_order_relaxed);
+        return MessageHandle<T>(&mSlots[index]);
+    }
+
+    /**
+     *  @return the number of messages that can be acquired.
+     */
+    inline uint32_t getAvailable() const
+    {
+        return mAvailable.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return the total number of messages in the pool.
+     */
+    inline uint32_t getSize() const
+    {
+        return mSize;
+    }
+
+private:
+    friend class MessageHandle<T>;
+
+    /** A single preallocated message. */
+    struct Slot
+    {
+        /** Number of handles referring to this slot. */
+        std::atomic<unsigned int> mReferences{0};
+        /** Index of the next free slot while this slot is on the free list. */
+        std::atomic<uint32_t> mNext{0};
+        /** The pool this slot belongs to. */
+        MessagePool* mPool{nullptr};
+        /** The message. */
+        T mValue;
+    };
+
+    /** Index marking the end of the free list. */
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    /**
+     * The free list head combines an index with a tag incremented on every change, which
+     * protects the compare-and-swap against the ABA problem.
+     */
+    static inline uint64_t pack(const uint32_t tag, const uint32_t index)
+    {
+        return (static_cast<uint64_t>(tag) << 32) | index;
+    }
+
+    static inline uint32_t tag(const uint64_t head)
+    {
+        return static_cast<uint32_t>(head >> 32);
+    }
+
+    /**
+     * Puts a slot back on the free list.
+     *  @param slot a slot whose last handle was dropped.
+     */
+    void release(Slot* slot)
+    {
+        uint32_t index = static_cast<uint32_t>(slot - mSlots.get());
+        uint64_t head = mFree.load(std::memory_order_acquire);
+        do
+        {
+            slot->mNext.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        }
+        while (!mFree.compare_exchange_weak(head, pack(tag(head) + 1, index), std::memory_order_acq_rel, std::memory_order_acquire));
+        mAvailable.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /** The number of messages in the pool. */
+    const uint32_t mSize;
+    /** Preallocated messages. */
+    std::unique_ptr<Slot[]> mSlots;
+    /** Head of the free list. */
+    std::atomic<uint64_t> mFree;
+    /** The number of messages on the free list. */
+    std::atomic<uint32_t> mAvailable;
+};
@@ -0,0 +1,230 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "histogram.h"
+#include "monotonic_clock.h"
+
+
+/**
+ * Instrumentation of talkers and listeners. It is compiled in only when UTILS_ENABLE_METRICS is
+ * defined; otherwise no metric is stored nor measured and takeMetricsSnapshot() returns nothing.
+ * As the macro changes the layout of talkers and listeners, it has to be defined (or not) in the
+ * same way for all translation units of a program.
+ */
+
+/**
+ * The role of an object whose metrics were collected.
+ */
+enum class MetricsKind
+{
+    TALKER,
+    LISTENER
+};
+
+/**
+ * Copy of metrics of a single talker or listener.
+ */
+struct MetricsRecord
+{
+    /** Address of the talker or listener, identifies it when no label was set. */
+    const void* mOwner;
+    /** The role of the object. */
+    MetricsKind mKind;
+    /** Label set with setMetricsLabel, empty by default. */
+    std::string mLabel;
+    /** Talker: the number of broadcasts. */
+    uint64_t mPublished;
+    /** Talker: the number of broadcasts suppressed because the talker was paused. */
+    uint64_t mPaused;
+    /** Talker: broadcasts that reached no listener. Listener: updates dropped for lack of space. */
+    uint64_t mDropped;
+    /** Listener: durations of update and updateBatch calls made by talkers, in nanoseconds. */
+    Histogram mUpdateTime;
+    /** Time spent waiting for the registration lock, in nanoseconds. Uncontended locks count as 0. */
+    Histogram mLockWait;
+};
+
+/** Metrics of all talkers and listeners that existed when the snapshot was taken. */
+using MetricsSnapshot = std::vector<MetricsRecord>;
+
+#ifdef UTILS_ENABLE_METRICS
+
+/**
+ * Live metrics of a single talker or listener. Each instance adds itself to a process-wide list
+ * on construction and removes itself on destruction, so that all of them can be collected at once.
+ */
+class ObjectMetrics
+{
+public:
+    /**
+     * Basic constructor that adds the metrics to the process-wide list. The owner is reported
+     * as a listener until setKind is called.
+     *  @param owner the talker or listener the metrics belong to.
+     */
+    explicit ObjectMetrics(const void* owner)
+    : mPublished(0), mPaused(0), mDropped(0), mOwner(owner), mKind(MetricsKind::LISTENER)
+    {
+        Registry& registry = getRegistry();
+        pthread_mutex_lock(&registry.mLock);
+        registry.mEntries.push_back(this);
+        pthread_mutex_unlock(&registry.mLock);
+    }
+
+    /**
+     * Class destructor that removes the metrics from the process-wide list.
+     */
+    ~ObjectMetrics()
+    {
+        Registry& registry = getRegistry();
+        pthread_mutex_lock(&registry.mLock);
+        for (size_t i = 0; i < registry.mEntries.size(); ++i)
+        {
+            if (this == registry.mEntries[i])
+            {
+                registry.mEntries[i] = registry.mEntries.back();
+                registry.mEntries.pop_back();
+                break;
+            }
+        }
+        pthread_mutex_unlock(&registry.mLock);
+    }
+
+    ObjectMetrics(const ObjectMetrics&) = delete;
+    ObjectMetrics& operator=(const ObjectMetrics&) = delete;
+
+    /**
+     * Sets the role of the owner.
+     *  @param kind the role of the owner.
+     */
+    void setKind(const MetricsKind kind)
+    {
+        Registry& registry = getRegistry();
+        pthread_mutex_lock(&registry.mLock);
+        mKind = kind;
+        pthread_mutex_unlock(&registry.mLock);
+    }
+
+    /**
+     * Sets a human readable name of the owner.
+     *  @param label the name reported in snapshots.
+     */
+    void setLabel(const std::string& label)
+    {
+        Registry& registry = getRegistry();
+        pthread_mutex_lock(&registry.mLock);
+        mLabel = label;
+        pthread_mutex_unlock(&registry.mLock);
+    }
+
+    /**
+     * Copies metrics of all talkers and listeners. No object can be created or destroyed while
+     * the snapshot is taken, so each one is reported exactly once and none is read after its
+     * destruction. Counters keep changing meanwhile and each one is read once, atomically.
+     *  @return the copied metrics.
+     */
+    static MetricsSnapshot snapshot()
+    {
+        MetricsSnapshot records;
+        Registry& registry = getRegistry();
+        pthread_mutex_lock(&registry.mLock);
+        records.reserve(registry.mEntries.size());
+        for (const ObjectMetrics* entry : registry.mEntries)
+        {
+            records.push_back({entry->mOwner, entry->mKind, entry->mLabel,
+                               entry->mPublished.load(std::memory_order_relaxed),
+                               entry->mPaused.load(std::memory_order_relaxed),
+                               entry->mDropped.load(std::memory_order_relaxed),
+                               entry->mUpdateTime, entry->mLockWait});
+        }
+        pthread_mutex_unlock(&registry.mLock);
+        return records;
+    }
+
+    /** The number of broadcasts. */
+    std::atomic<uint64_t> mPublished;
+    /** The number of broadcasts suppressed by pause. */
+    std::atomic<uint64_t> mPaused;
+    /** The number of broadcasts or updates that were dropped. */
+    std::atomic<uint64_t> mDropped;
+    /** Durations of update calls. */
+    Histogram mUpdateTime;
+    /** Time spent waiting for the registration lock. */
+    Histogram mLockWait;
+
+private:
+    /**
+     * The process-wide list of metrics.
+     */
+    struct Registry
+    {
+        Registry()
+        {
+            pthread_mutex_init(&mLock, nullptr);
+        }
+
+        ~Registry()
+        {
+            pthread_mutex_destroy(&mLock);
+        }
+
+        pthread_mutex_t mLock;
+        std::vector<const ObjectMetrics*> mEntries;
+    };
+
+    /**
+     *  @return the process-wide list, created on first use so that it outlives all its entries.
+     */
+    static Registry& getRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    /** The talker or listener the metrics belong to. */
+    const void* mOwner;
+    /** The role of the owner. */
+    MetricsKind mKind;
+    /** Human readable name of the owner. */
+    std::string mLabel;
+};
+
+#endif
+
+/**
+ * Copies metrics of all talkers and listeners in the process.
+ *  @return the copied metrics, empty if metrics are compiled out.
+ */
+inline MetricsSnapshot takeMetricsSnapshot()
+{
+#ifdef UTILS_ENABLE_METRICS
+    return ObjectMetrics::snapshot();
+#else
+    return MetricsSnapshot();
+#endif
+}
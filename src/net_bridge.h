@@ -0,0 +1,647 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <type_traits>
+#include <unistd.h>
+#include "generic_listener.h"
+#include "generic_talker.h"
+#include "generic_thread.h"
+#include "ring_utils.h"
+
+
+/**
+ * The transport used by a network bridge.
+ */
+enum class NetProtocol
+{
+    /** One datagram per payload, sent and received in batches with sendmmsg and recvmmsg. */
+    UDP,
+    /** A stream of frames, sent with scatter-gather writes of whole batches. */
+    TCP
+};
+
+/**
+ * A payload as it is sent over the network: a header followed by the raw bytes of the payload.
+ * Both ends must therefore run on the same architecture and use the same payload type.
+ */
+template<typename T>
+struct NetFrame
+{
+    /** Value identifying frames of the bridge. */
+    static constexpr uint32_t MAGIC = 0x4e455442;
+
+    /** Equal to MAGIC. */
+    uint32_t mMagic;
+    /** The size of the payload, checked by receivers. */
+    uint32_t mSize;
+    /** The number of frames sent before this one, used by receivers to count lost frames. */
+    uint64_t mSequence;
+    /** The payload. */
+    T mPayload;
+};
+
+/**
+ * Sends trivially copyable payloads to a NetReceiver, usually in another process. It is a
+ * listener, so it can be registered to a talker to bridge its output to the network. update only
+ * copies the payload into a frame of a preallocated ring; a sender thread transmits all frames
+ * waiting in the ring at once, straight from the ring, so the publishing thread never makes a
+ * system call and nothing is allocated per payload. If the ring is full, the payload is dropped
+ * and counted. Updates must come from one publishing thread at a time. The stream is written
+ * without blocking, so a receiver that stops reading cannot hang the destructor: frames still
+ * waiting for it are given up after DRAIN_TIMEOUT, and the connection is shut down.
+ * Lock is the lock of the talkers feeding the publisher.
+ */
+template<typename Lock, typename T>
+class BasicNetPublisher : public BasicListener<Lock, T>, public GenericThread<BasicNetPublisher<Lock, T>>
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Network payloads must be trivially copyable");
+
+public:
+    /** The maximum number of frames sent by one system call. */
+    static constexpr size_t BATCH = 64;
+    /** Time in milliseconds the destructor waits for a stalled receiver to accept the stream. */
+    static constexpr int DRAIN_TIMEOUT = 1000;
+
+    /**
+     * Basic constructor that connects to a receiver and starts the sender thread.
+     *  @param protocol the transport, which must match the one of the receiver.
+     *  @param host the IPv4 address of the receiver, e.g. "127.0.0.1".
+     *  @param port the port of the receiver.
+     *  @param capacity the number of frames the ring can hold, rounded up to a power of two.
+     */
+    BasicNetPublisher(const NetProtocol protocol, const std::string& host, const uint16_t port, const size_t capacity = 1024)
+    : BasicListener<Lock, T>(), GenericThread<BasicNetPublisher<Lock, T>>(), mProtocol(protocol), mCapacity(roundUpToPowerOfTwo(capacity)),
+      mFrames(new NetFrame<T>[mCapacity]), mSocket(-1), mWakeup(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)), mDraining(false),
+      mHead(0), mTail(0), mSent(0), mDropped(0)
+    {
+        // value-initialisation does not reliably zero padding, so the ring is cleared byte by byte.
+        memset(static_cast<void*>(mFrames.get()), 0, mCapacity * sizeof(NetFrame<T>));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        if (mWakeup >= 0 && 1 == inet_pton(AF_INET, host.c_str(), &address.sin_addr))
+        {
+            mSocket = socket(AF_INET, (NetProtocol::UDP == protocol ? SOCK_DGRAM : SOCK_STREAM) | SOCK_CLOEXEC, 0);
+        }
+        if (mSocket >= 0)
+        {
+            // batches are formed by the sender thread, so Nagle's algorithm would only add latency.
+            int enable = 1;
+            if (NetProtocol::TCP == protocol)
+            {
+                setsockopt(mSocket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+            }
+            if (0 == connect(mSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)))
+            {
+                this->startThread();
+            }
+            else
+            {
+                close(mSocket);
+                mSocket = -1;
+            }
+        }
+    }
+
+    /**
+     * Class destructor that sends the frames waiting in the ring and closes the connection.
+     */
+    virtual ~BasicNetPublisher()
+    {
+        this->unregisterAll();
+        if (mWakeup >= 0)
+        {
+            // wakes up the sender thread if it waits for a receiver that does not read.
+            uint64_t one = 1;
+            ssize_t result = write(mWakeup, &one, sizeof(one));
+            (void) result;
+        }
+        this->stopThread();
+        for (int fd : {mSocket, mWakeup})
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+    }
+
+    /**
+     *  @return true if the publisher is connected.
+     */
+    inline bool isOpen() const
+    {
+        return mSocket >= 0;
+    }
+
+    /**
+     * Copies the payload into the ring and wakes up the sender thread.
+     *  @param data the payload to send.
+     *  @return false if the payload was dropped because the ring was full.
+     */
+    bool publish(const T& data)
+    {
+        uint64_t tail = mTail.load(std::memory_order_relaxed);
+        if (mSocket < 0 || tail - mHead.load(std::memory_order_acquire) == mCapacity)
+        {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        NetFrame<T>& frame = mFrames[tail & (mCapacity - 1)];
+        frame.mMagic = NetFrame<T>::MAGIC;
+        frame.mSize = sizeof(T);
+        frame.mSequence = tail;
+        memcpy(&frame.mPayload, &data, sizeof(T));
+        mTail.store(tail + 1, std::memory_order_release);
+        this->mEvent.notify();
+        return true;
+    }
+
+    /**
+     * Sends the update of a talker this publisher is registered to.
+     *  @param data a new data broadcasted by a talker.
+     */
+    void update(const T& data) override
+    {
+        if (!publish(data))
+        {
+            this->countDropped();
+        }
+    }
+
+    /**
+     *  @return the number of frames handed over to the kernel.
+     */
+    inline uint64_t getSent() const
+    {
+        return mSent.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return the number of payloads dropped because the ring was full or sending failed.
+     */
+    inline uint64_t getDropped() const
+    {
+        return mDropped.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Sends frames as they are published, and those still waiting once the thread is stopped.
+     */
+    void* threadBody()
+    {
+        bool running = true;
+        do
+        {
+            running = this->isRunning();
+            uint64_t head = mHead.load(std::memory_order_relaxed);
+            uint64_t tail = mTail.load(std::memory_order_acquire);
+            if (head == tail)
+            {
+                if (running)
+                {
+                    this->mEvent.wait();
+                }
+                continue;
+            }
+            size_t count = tail - head < BATCH ? static_cast<size_t>(tail - head) : BATCH;
+            size_t sent = NetProtocol::UDP == mProtocol ? sendDatagrams(head, count) : sendStream(head, count);
+            mSent.fetch_add(sent, std::memory_order_relaxed);
+            mDropped.fetch_add(count - sent, std::memory_order_relaxed);
+            mHead.store(head + count, std::memory_order_release);
+        }
+        while (running || mHead.load(std::memory_order_relaxed) != mTail.load(std::memory_order_acquire));
+        return nullptr;
+    }
+
+private:
+    /**
+     * Sends frames as datagrams with as few sendmmsg calls as possible.
+     *  @param head the index of the first frame.
+     *  @param count the number of frames.
+     *  @return the number of frames sent, the others were dropped.
+     */
+    size_t sendDatagrams(const uint64_t head, const size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            mIovecs[i].iov_base = &mFrames[(head + i) & (mCapacity - 1)];
+            mIovecs[i].iov_len = sizeof(NetFrame<T>);
+            mMessages[i] = {};
+            mMessages[i].msg_hdr.msg_iov = &mIovecs[i];
+            mMessages[i].msg_hdr.msg_iovlen = 1;
+        }
+        size_t done = 0;
+        size_t sent = 0;
+        while (done < count)
+        {
+            int result = sendmmsg(mSocket, &mMessages[done], static_cast<unsigned int>(count - done), 0);
+            if (result > 0)
+            {
+                done += static_cast<size_t>(result);
+                sent += static_cast<size_t>(result);
+            }
+            else if (result < 0 && EINTR != errno)
+            {
+                // e.g. ECONNREFUSED while no receiver is bound, or ENOBUFS; the datagram is dropped and counted.
+                ++done;
+            }
+        }
+        return sent;
+    }
+
+    /**
+     * Writes frames into the stream with one scatter-gather call, which covers both parts of the
+     * ring if the frames wrap around it. Partial writes are continued once the socket can take
+     * more data; after the destructor was called, for at most DRAIN_TIMEOUT.
+     *  @param head the index of the first frame.
+     *  @param count the number of frames.
+     *  @return the number of frames sent completely, lower than @p count if the connection failed.
+     */
+    size_t sendStream(const uint64_t head, const size_t count)
+    {
+        size_t first = head & (mCapacity - 1);
+        size_t contiguous = mCapacity - first < count ? mCapacity - first : count;
+        iovec iovecs[2] = {{&mFrames[first], contiguous * sizeof(NetFrame<T>)},
+                           {&mFrames[0], (count - contiguous) * sizeof(NetFrame<T>)}};
+        msghdr message = {};
+        message.msg_iov = iovecs;
+        message.msg_iovlen = count > contiguous ? 2 : 1;
+        size_t total = 0;
+        while (message.msg_iovlen > 0)
+        {
+            // sendmsg is used as writev, with MSG_NOSIGNAL so that a closed receiver does not raise SIGPIPE.
+            ssize_t written = sendmsg(mSocket, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (written < 0)
+            {
+                if (EINTR == errno || ((EAGAIN == errno || EWOULDBLOCK == errno) && waitWritable()))
+                {
+                    continue;
+                }
+                return total / sizeof(NetFrame<T>);
+            }
+            total += static_cast<size_t>(written);
+            while (message.msg_iovlen > 0 && static_cast<size_t>(written) >= message.msg_iov->iov_len)
+            {
+                written -= static_cast<ssize_t>(message.msg_iov->iov_len);
+                ++message.msg_iov;
+                --message.msg_iovlen;
+            }
+            if (message.msg_iovlen > 0)
+            {
+                message.msg_iov->iov_base = static_cast<char*>(message.msg_iov->iov_base) + written;
+                message.msg_iov->iov_len -= static_cast<size_t>(written);
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Waits until the stream can take more data. Once the destructor was called, waits for at most
+     * DRAIN_TIMEOUT and then shuts the connection down, as a frame cut in the middle cannot be resumed.
+     *  @return false if the connection was shut down.
+     */
+    bool waitWritable()
+    {
+        pollfd fds[2] = {{mSocket, POLLOUT, 0}, {mWakeup, POLLIN, 0}};
+        int result = poll(fds, mDraining ? 1 : 2, mDraining ? DRAIN_TIMEOUT : -1);
+        if (0 == result)
+        {
+            shutdown(mSocket, SHUT_RDWR);
+            return false;
+        }
+        mDraining = mDraining || 0 != (fds[1].revents & POLLIN);
+        return true;
+    }
+
+    /** The transport. */
+    const NetProtocol mProtocol;
+    /** The number of frames in the ring. */
+    const size_t mCapacity;
+    /** The ring of frames, zeroed once so that padding bytes, which are never written, are sent as zeros. */
+    std::unique_ptr<NetFrame<T>[]> mFrames;
+    /** Messages of a batch of datagrams, used only by the sender thread. */
+    mmsghdr mMessages[BATCH];
+    /** Buffers of a batch of datagrams, used only by the sender thread. */
+    iovec mIovecs[BATCH];
+    /** The connected socket, -1 if the connection failed. */
+    int mSocket;
+    /** Event file descriptor used to wake up the sender thread when the publisher is destroyed. */
+    int mWakeup;
+    /** Flag indicating that the destructor was called, used only by the sender thread. */
+    bool mDraining;
+    /** Index of the next frame to send, written only by the sender thread. */
+    alignas(64) std::atomic<uint64_t> mHead;
+    /** Index of the next frame to fill, written only by the publisher. */
+    alignas(64) std::atomic<uint64_t> mTail;
+    /** The number of sent frames. */
+    std::atomic<uint64_t> mSent;
+    /** The number of dropped payloads. */
+    std::atomic<uint64_t> mDropped;
+};
+
+/**
+ * Network publisher with the lock selected by LockPolicy.
+ */
+template<typename T>
+using NetPublisher = BasicNetPublisher<typename LockPolicy<T>::Type, T>;
+
+/**
+ * Receives payloads sent by a NetPublisher and broadcasts them to its listeners from its own
+ * thread. Datagrams are read in batches with recvmmsg and the stream in large chunks, both into
+ * a preallocated array of frames, and listeners get a reference to the payload inside that
+ * array, so nothing is copied or allocated per payload; they must not keep the reference past
+ * update. A TCP receiver serves one connection at a time and accepts the next one when it closes.
+ * Lost frames are counted per connection for TCP, and assuming a single publisher for UDP.
+ */
+template<typename T>
+class NetReceiver : public GenericTalker<T>, public GenericThread<NetReceiver<T>>
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Network payloads must be trivially copyable");
+
+public:
+    /** The maximum number of frames received by one system call. */
+    static constexpr size_t BATCH = 64;
+
+    /**
+     * Basic constructor that binds the socket and starts receiving.
+     *  @param protocol the transport, which must match the one of publishers.
+     *  @param port the port to listen on, 0 to let the system choose one (see getPort()).
+     *  @param host the IPv4 address to listen on.
+     *  @param bufferSize the size of the socket receive buffer in bytes, 0 to keep the system default.
+     */
+    NetReceiver(const NetProtocol protocol, const uint16_t port, const std::string& host = "127.0.0.1", const int bufferSize = 0)
+    : GenericTalker<T>(), GenericThread<NetReceiver<T>>(), mProtocol(protocol), mSocket(-1), mConnection(-1),
+      mWakeup(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)), mPort(0), mExpected(0), mReceived(0), mLost(0), mInvalid(0)
+    {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        if (mWakeup >= 0 && 1 == inet_pton(AF_INET, host.c_str(), &address.sin_addr))
+        {
+            mSocket = socket(AF_INET, (NetProtocol::UDP == protocol ? SOCK_DGRAM : SOCK_STREAM) | SOCK_CLOEXEC, 0);
+        }
+        if (mSocket >= 0)
+        {
+            int enable = 1;
+            setsockopt(mSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+            if (bufferSize > 0)
+            {
+                setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+            }
+            socklen_t length = sizeof(address);
+            if (0 == bind(mSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address))
+                && (NetProtocol::UDP == protocol || 0 == listen(mSocket, 1))
+                && 0 == getsockname(mSocket, reinterpret_cast<sockaddr*>(&address), &length))
+            {
+                mPort = ntohs(address.sin_port);
+                for (size_t i = 0; i < BATCH; ++i)
+                {
+                    mIovecs[i] = {&mFrames[i], sizeof(NetFrame<T>)};
+                }
+                this->startThread();
+            }
+            else
+            {
+                close(mSocket);
+                mSocket = -1;
+            }
+        }
+    }
+
+    /**
+     * Class destructor that stops receiving and closes all sockets.
+     */
+    virtual ~NetReceiver()
+    {
+        this->requestStop();
+        if (mWakeup >= 0)
+        {
+            uint64_t one = 1;
+            ssize_t result = write(mWakeup, &one, sizeof(one));
+            (void) result;
+        }
+        this->stopThread();
+        for (int fd : {mConnection, mSocket, mWakeup})
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+    }
+
+    /**
+     *  @return true if the receiver is listening.
+     */
+    inline bool isOpen() const
+    {
+        return mSocket >= 0;
+    }
+
+    /**
+     *  @return the port the receiver listens on.
+     */
+    inline uint16_t getPort() const
+    {
+        return mPort;
+    }
+
+    /**
+     *  @return the number of broadcast payloads.
+     */
+    inline uint64_t getReceived() const
+    {
+        return mReceived.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return the number of frames lost on the way, detected from gaps in their sequence numbers.
+     */
+    inline uint64_t getLost() const
+    {
+        return mLost.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return the number of discarded datagrams or connections that did not carry valid frames.
+     */
+    inline uint64_t getInvalid() const
+    {
+        return mInvalid.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Broadcasts payloads as they arrive until the receiver is destroyed.
+     */
+    void* threadBody()
+    {
+        size_t filled = 0;
+        while (this->isRunning())
+        {
+            int fd = NetProtocol::TCP == mProtocol && mConnection >= 0 ? mConnection : mSocket;
+            pollfd fds[2] = {{fd, POLLIN, 0}, {mWakeup, POLLIN, 0}};
+            if (poll(fds, 2, -1) <= 0 || 0 == (fds[0].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                continue;
+            }
+            if (NetProtocol::UDP == mProtocol)
+            {
+                receiveDatagrams();
+            }
+            else if (fd == mSocket)
+            {
+                mConnection = accept4(mSocket, nullptr, nullptr, SOCK_CLOEXEC);
+                mExpected = 0;
+                filled = 0;
+            }
+            else if (!receiveStream(filled))
+            {
+                close(mConnection);
+                mConnection = -1;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    /**
+     * Reads all waiting datagrams, up to BATCH at a time, and broadcasts their payloads.
+     */
+    void receiveDatagrams()
+    {
+        int count;
+        do
+        {
+            for (size_t i = 0; i < BATCH; ++i)
+            {
+                mMessages[i] = {};
+                mMessages[i].msg_hdr.msg_iov = &mIovecs[i];
+                mMessages[i].msg_hdr.msg_iovlen = 1;
+            }
+            count = recvmmsg(mSocket, mMessages, BATCH, MSG_DONTWAIT, nullptr);
+            for (int i = 0; i < count; ++i)
+            {
+                if (sizeof(NetFrame<T>) == mMessages[i].msg_len)
+                {
+                    broadcast(mFrames[i]);
+                }
+                else
+                {
+                    mInvalid.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+        while (static_cast<int>(BATCH) == count);
+    }
+
+    /**
+     * Reads a chunk of the stream and broadcasts all complete frames. As all frames have the same
+     * size, frames start at multiples of it and are read in place; a partial frame is moved to
+     * the beginning of the array.
+     *  @param[in,out] filled the number of bytes in the array.
+     *  @return false if the connection was closed or carried an invalid frame.
+     */
+    bool receiveStream(size_t& filled)
+    {
+        ssize_t result = recv(mConnection, reinterpret_cast<char*>(mFrames) + filled, sizeof(mFrames) - filled, MSG_DONTWAIT);
+        if (result <= 0)
+        {
+            return result < 0 && (EAGAIN == errno || EINTR == errno);
+        }
+        filled += static_cast<size_t>(result);
+        size_t complete = filled / sizeof(NetFrame<T>);
+        for (size_t i = 0; i < complete; ++i)
+        {
+            if (!broadcast(mFrames[i]))
+            {
+                return false;
+            }
+        }
+        filled -= complete * sizeof(NetFrame<T>);
+        memmove(static_cast<void*>(mFrames), &mFrames[complete], filled);
+        return true;
+    }
+
+    /**
+     * Checks a frame, counts frames lost before it and broadcasts its payload.
+     *  @param frame the received frame.
+     *  @return false if the frame is invalid.
+     */
+    bool broadcast(const NetFrame<T>& frame)
+    {
+        if (NetFrame<T>::MAGIC != frame.mMagic || sizeof(T) != frame.mSize)
+        {
+            mInvalid.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (frame.mSequence > mExpected)
+        {
+            mLost.fetch_add(frame.mSequence - mExpected, std::memory_order_relaxed);
+        }
+        mExpected = frame.mSequence + 1;
+        this->notifyListeners(frame.mPayload);
+        mReceived.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /** The transport. */
+    const NetProtocol mProtocol;
+    /** The bound socket, listening for connections if the transport is TCP. */
+    int mSocket;
+    /** The accepted TCP connection, -1 if there is none. */
+    int mConnection;
+    /** Event file descriptor used to wake up the thread when it should stop. */
+    int mWakeup;
+    /** The port the receiver listens on. */
+    uint16_t mPort;
+    /** The sequence number of the next expected frame. */
+    uint64_t mExpected;
+    /** Frames being received. */
+    NetFrame<T> mFrames[BATCH];
+    /** Messages of a batch of datagrams. */
+    mmsghdr mMessages[BATCH];
+    /** Buffers of a batch of datagrams, one frame each. */
+    iovec mIovecs[BATCH];
+    /** The number of broadcast payloads. */
+    std::atomic<uint64_t> mReceived;
+    /** The number of lost frames. */
+    std::atomic<uint64_t> mLost;
+    /** The number of invalid datagrams or connections. */
+    std::atomic<uint64_t> mInvalid;
+};
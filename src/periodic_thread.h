@@ -0,0 +1,194 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "generic_thread.h"
+#include "histogram.h"
+#include "monotonic_clock.h"
+
+
+/**
+ * Defines what a periodic thread does when a cycle finishes after the next deadline.
+ */
+enum class OverrunPolicy
+{
+    /** Missed deadlines are skipped and the next cycle starts at the next deadline in the future. */
+    SKIP,
+    /** Missed cycles are run back to back until the thread catches up with the schedule. */
+    CATCH_UP
+};
+
+/**
+ * A thread that calls Derived::cycle() at a fixed rate. Deadlines are absolute, computed from
+ * the start time and the period, and the thread sleeps until the next one on its event with an
+ * absolute CLOCK_MONOTONIC timeout, so the time spent in cycle() and wake-up delays do not
+ * accumulate into drift. The delay between
+ * each deadline and the actual wake-up (jitter) and the duration of each cycle are recorded in
+ * histograms that can be read while the thread runs.
+ */
+template<typename Derived>
+class PeriodicThread : public GenericThread<Derived>
+{
+public:
+    /**
+     * Basic constructor.
+     *  @param period the period of the thread in nanoseconds. It must be positive, otherwise the
+     *         thread does not start.
+     *  @param policy the behaviour when a cycle overruns its period.
+     */
+    explicit PeriodicThread(const int64_t period, const OverrunPolicy policy = OverrunPolicy::SKIP)
+    : GenericThread<Derived>(), mPeriod(period), mPolicy(policy), mCycles(0), mOverruns(0), mSkipped(0)
+    {
+        // spinning at the start of a period would only burn the CPU.
+        this->mEvent.setSpins(0);
+    }
+
+    /**
+     * Starts the thread.
+     *  @return false if the period is not positive or the thread could not be created.
+     */
+    bool startThread()
+    {
+        return mPeriod > 0 && GenericThread<Derived>::startThread();
+    }
+
+    /**
+     * Starts the thread with the given settings, see GenericThread::startThread.
+     *  @param config the settings of the thread.
+     *  @return false if the period is not positive or the thread could not be created.
+     */
+    bool startThread(const ThreadConfig& config)
+    {
+        return mPeriod > 0 && GenericThread<Derived>::startThread(config);
+    }
+
+    /**
+     * Calls Derived::cycle() at every deadline until the thread is stopped.
+     */
+    void* threadBody()
+    {
+        if (mPeriod <= 0)
+        {
+            // a zero period would spin without sleeping and divide by zero after an overrun.
+            return nullptr;
+        }
+        int64_t deadline = monotonicNow() + mPeriod;
+        while (this->isRunning())
+        {
+            // the event is raised by stopThread, so stopping does not wait for the next deadline.
+            while (this->isRunning() && this->mEvent.waitUntil(deadline))
+            {
+            }
+            if (!this->isRunning())
+            {
+                break;
+            }
+            int64_t start = monotonicNow();
+            mJitter.record(start - deadline);
+
+            static_cast<Derived*>(this)->cycle();
+            int64_t end = monotonicNow();
+            mCycleTime.record(end - start);
+            mCycles.fetch_add(1, std::memory_order_relaxed);
+
+            deadline += mPeriod;
+            if (end > deadline)
+            {
+                mOverruns.fetch_add(1, std::memory_order_relaxed);
+                if (OverrunPolicy::SKIP == mPolicy)
+                {
+                    int64_t missed = (end - deadline) / mPeriod + 1;
+                    deadline += missed * mPeriod;
+                    mSkipped.fetch_add(static_cast<uint64_t>(missed), std::memory_order_relaxed);
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     *  @return the period of the thread in nanoseconds.
+     */
+    inline int64_t getPeriod() const
+    {
+        return mPeriod;
+    }
+
+    /**
+     *  @return histogram of delays in nanoseconds between deadlines and actual wake-ups.
+     */
+    inline const Histogram& getJitter() const
+    {
+        return mJitter;
+    }
+
+    /**
+     *  @return histogram of cycle() durations in nanoseconds.
+     */
+    inline const Histogram& getCycleTime() const
+    {
+        return mCycleTime;
+    }
+
+    /**
+     *  @return the number of completed cycles.
+     */
+    inline uint64_t getCycles() const
+    {
+        return mCycles.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return the number of cycles that finished after the next deadline.
+     */
+    inline uint64_t getOverruns() const
+    {
+        return mOverruns.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return the number of deadlines skipped due to overruns.
+     */
+    inline uint64_t getSkipped() const
+    {
+        return mSkipped.load(std::memory_order_relaxed);
+    }
+
+private:
+    /** The period of the thread in nanoseconds. */
+    const int64_t mPeriod;
+    /** The behaviour when a cycle overruns its period. */
+    const OverrunPolicy mPolicy;
+    /** Delays between deadlines and actual wake-ups. */
+    Histogram mJitter;
+    /** Durations of cycles. */
+    Histogram mCycleTime;
+    /** The number of completed cycles. */
+    std::atomic<uint64_t> mCycles;
+    /** The number of cycles that finished after the next deadline. */
+    std::atomic<uint64_t> mOverruns;
+    /** The number of deadlines skipped due to overruns. */
+    std::atomic<uint64_t> mSkipped;
+};
@@ -0,0 +1,298 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <sched.h>
+#include <type_traits>
+#include "generic_listener.h"
+#include "generic_talker.h"
+#include "generic_thread.h"
+#include "locks.h"
+#include "scoped_lock.h"
+#include "spsc_queue.h"
+#include "thread_pool.h"
+
+
+/**
+ * A stage of a processing pipeline: a listener of In that processes its inputs on its own thread,
+ * or on a shared thread pool, and a talker of Out that publishes the results. Inputs wait in a
+ * bounded queue, so stages connected with connectTo run concurrently and the throughput of a
+ * pipeline is that of its slowest stage. A full queue applies its overflow policy: BLOCK stalls
+ * the publisher of the previous stage until there is space, which propagates backpressure up to
+ * the source; DROP_NEWEST discards new inputs; DROP_OLDEST with the smallest capacity conflates
+ * inputs, so that a slow stage skips stale inputs and soon gets to the latest one.
+ *
+ * Derived classes implement process() and publish with notifyListeners. They must call stop()
+ * in their destructors, so that process() is not called on a partially destroyed object.
+ * InLock is the lock of the talkers feeding the stage, and OutLock the lock of the listeners
+ * the stage publishes to.
+ */
+template<typename InLock, typename OutLock, typename In, typename Out>
+class BasicPipelineStage : public BasicListener<InLock, In>, public BasicTalker<OutLock, Out>, public GenericThread<BasicPipelineStage<InLock, OutLock, In, Out>>
+{
+    static_assert(std::is_default_constructible<In>::value, "PipelineStage requires a default constructible input");
+
+public:
+    using BasicListener<InLock, In>::registerTo;
+    using BasicListener<InLock, In>::unregisterFrom;
+    using BasicTalker<OutLock, Out>::registerTo;
+    using BasicTalker<OutLock, Out>::unregisterFrom;
+
+    /**
+     * Basic constructor that starts the stage.
+     *  @param capacity the number of inputs that can be queued.
+     *  @param policy the behaviour when the queue is full.
+     *  @param pool the pool to process inputs on, or nullptr to process them on a dedicated thread.
+     */
+    explicit BasicPipelineStage(const size_t capacity, const OverflowPolicy policy = OverflowPolicy::BLOCK, ThreadPool* pool = nullptr)
+    : BasicListener<InLock, In>(), BasicTalker<OutLock, Out>(), GenericThread<BasicPipelineStage<InLock, OutLock, In, Out>>(), mQueue(capacity, policy), mPolicy(policy),
+      mPool(pool), mScheduled(false), mPendingTasks(0), mConsuming(false), mProcessed(0), mStopped(false)
+    {
+        if (nullptr == mPool)
+        {
+            this->startThread();
+        }
+    }
+
+    /**
+     * Class destructor. Derived classes must have called stop() already, which is asserted in
+     * debug builds: process() cannot be called anymore once the derived class is destroyed.
+     */
+    virtual ~BasicPipelineStage()
+    {
+        assert(mStopped.load(std::memory_order_acquire) && "derived stages have to call stop() in their destructors");
+        stop();
+    }
+
+    /**
+     * Unregisters from the talkers feeding the stage, processes inputs that are still queued and
+     * stops the stage. Can be called more than once.
+     */
+    void stop()
+    {
+        if (mStopped.exchange(true, std::memory_order_acq_rel))
+        {
+            return;
+        }
+        BasicListener<InLock, In>::unregisterAll();
+        if (nullptr == mPool)
+        {
+            this->stopThread();
+        }
+        else
+        {
+            while (0 != mPendingTasks.load(std::memory_order_acquire))
+            {
+                if (!mPool->runPending())
+                {
+                    sched_yield();
+                }
+            }
+            while (consume(mQueue.getCapacity()) || !mQueue.isEmpty())
+            {
+            }
+        }
+    }
+
+    /**
+     * Connects the output of the stage to the next stage or another listener. Unlike registerTo,
+     * it is not ambiguous when In and Out are the same type.
+     *  @param next the listener to receive the outputs.
+     */
+    inline void connectTo(BasicListener<OutLock, Out>* next)
+    {
+        BasicTalker<OutLock, Out>::registerTo(next);
+    }
+
+    /**
+     * Disconnects the output of the stage from a listener.
+     *  @param next the listener that no longer receives the outputs.
+     */
+    inline void disconnectFrom(BasicListener<OutLock, Out>* next)
+    {
+        BasicTalker<OutLock, Out>::unregisterFrom(next);
+    }
+
+    /**
+     * Queues an input, applying the overflow policy if the queue is full.
+     *  @param input a new input published by the previous stage.
+     */
+    void update(const In& input) override
+    {
+        ScopedLock lock(mPushLock);
+        if (nullptr != mPool && OverflowPolicy::BLOCK == mPolicy)
+        {
+            // a worker of the pool may be the one blocked, so the publisher processes the stage itself.
+            while (mQueue.isFull())
+            {
+                if (!consume(BATCH))
+                {
+                    sched_yield();
+                }
+            }
+        }
+        if (!mQueue.push(input))
+        {
+            this->countDropped();
+            return;
+        }
+        if (nullptr == mPool)
+        {
+            this->mEvent.notify();
+        }
+        else
+        {
+            schedule();
+        }
+    }
+
+    /**
+     * Processes queued inputs on the dedicated thread until the stage is stopped.
+     */
+    void* threadBody()
+    {
+        while (this->isRunning())
+        {
+            this->mEvent.wait();
+            while (consume(BATCH))
+            {
+            }
+        }
+        // inputs queued before the stop request may have been missed by the last pass.
+        while (consume(BATCH))
+        {
+        }
+        return nullptr;
+    }
+
+    /**
+     *  @return the number of processed inputs.
+     */
+    inline uint64_t getProcessed() const
+    {
+        return mProcessed.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return the number of inputs dropped or conflated because the queue was full.
+     */
+    inline size_t getDropped() const
+    {
+        return mQueue.getDropped();
+    }
+
+protected:
+    /**
+     * Processes a single input. Called for one input at a time, in the order they were queued.
+     *  @param input the input to process.
+     */
+    virtual void process(const In& input) = 0;
+
+private:
+    /** The maximum number of inputs processed by a single task of the pool. */
+    static constexpr size_t BATCH = 64;
+
+    /**
+     * Processes queued inputs unless another thread is already doing so.
+     *  @param count the maximum number of inputs to process.
+     *  @return true if any input was processed.
+     */
+    bool consume(const size_t count)
+    {
+        if (mConsuming.exchange(true, std::memory_order_acquire))
+        {
+            return false;
+        }
+        size_t processed = 0;
+        while (processed < count && mQueue.pop(mInput))
+        {
+            process(mInput);
+            ++processed;
+        }
+        mProcessed.fetch_add(processed, std::memory_order_relaxed);
+        mConsuming.store(false, std::memory_order_release);
+        return processed > 0;
+    }
+
+    /**
+     * Submits a task processing the queue to the pool, unless one is already pending.
+     */
+    void schedule()
+    {
+        if (!mScheduled.exchange(true, std::memory_order_acq_rel))
+        {
+            mPendingTasks.fetch_add(1, std::memory_order_acq_rel);
+            mPool->submit({&BasicPipelineStage::run, this, 0});
+        }
+    }
+
+    /**
+     * A task of the pool: processes a batch of inputs and resubmits itself if more are queued,
+     * so that stages sharing the pool take turns.
+     *  @param context the stage.
+     */
+    static void run(void* context, size_t)
+    {
+        BasicPipelineStage* stage = static_cast<BasicPipelineStage*>(context);
+        // cleared first, so that an input queued meanwhile schedules another task.
+        stage->mScheduled.store(false, std::memory_order_release);
+        stage->consume(BATCH);
+        if (!stage->mQueue.isEmpty())
+        {
+            stage->schedule();
+        }
+        // the stage may be destroyed right after this.
+        stage->mPendingTasks.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    /** Inputs waiting to be processed. */
+    SpscQueue<In> mQueue;
+    /** The behaviour when the queue is full. */
+    const OverflowPolicy mPolicy;
+    /** The pool to process inputs on, nullptr for the dedicated thread. */
+    ThreadPool* const mPool;
+    /** Raised while a task of the pool is submitted and has not started yet. */
+    std::atomic<bool> mScheduled;
+    /** The number of submitted tasks that have not finished yet. */
+    std::atomic<int> mPendingTasks;
+    /** Raised while a thread processes inputs, so that there is a single consumer of the queue. */
+    std::atomic<bool> mConsuming;
+    /** The number of processed inputs. */
+    std::atomic<uint64_t> mProcessed;
+    /** Raised once the stage was stopped. */
+    std::atomic<bool> mStopped;
+    /** Serialises publishers of the previous stages, as the queue has a single producer. */
+    Mutex mPushLock;
+    /** Input popped from the queue, kept as a member to reuse its storage. */
+    In mInput;
+};
+
+/**
+ * Pipeline stage with the locks selected by LockPolicy for its input and its output.
+ */
+template<typename In, typename Out>
+using PipelineStage = BasicPipelineStage<typename LockPolicy<In>::Type, typename LockPolicy<Out>::Type, In, Out>;
@@ -0,0 +1,225 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <sched.h>
+#include <vector>
+#include "scoped_lock.h"
+
+
+/**
+ * A read-copy-update container that holds an immutable value of type T. Readers access
+ * the current value through a ReadGuard without taking any lock, while writers publish
+ * a new copy and wait for a grace period before the old copy is reclaimed. Readers are
+ * tracked with two epoch counters so that a continuous stream of new readers cannot
+ * starve a writer. A new value can be exchanged under a lock of the writer, and the grace
+ * period awaited by reclaim once that lock was released, so that a reader waiting for
+ * the same lock cannot dead-lock the writer.
+ */
+template<typename T>
+class RcuSnapshot
+{
+public:
+    /**
+     * Read-side critical section. The value obtained through the guard stays valid
+     * until the guard goes out of scope.
+     */
+    class ReadGuard
+    {
+    public:
+        /**
+         * Enters the read-side critical section.
+         *  @param snapshot the snapshot to read.
+         */
+        explicit ReadGuard(const RcuSnapshot& snapshot) : mSnapshot(snapshot), mPrevious(sInnermost)
+        {
+            mIndex = mSnapshot.mEpoch.load(std::memory_order_seq_cst) & 1u;
+            mSnapshot.mReaders[mIndex].mCount.fetch_add(1, std::memory_order_seq_cst);
+            mValue = mSnapshot.mCurrent.load(std::memory_order_seq_cst);
+            sInnermost = this;
+        }
+
+        /**
+         * Leaves the read-side critical section.
+         */
+        ~ReadGuard()
+        {
+            sInnermost = mPrevious;
+            mSnapshot.mReaders[mIndex].mCount.fetch_sub(1, std::memory_order_release);
+        }
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        inline const T& operator*() const
+        {
+            return *mValue;
+        }
+
+        inline const T* operator->() const
+        {
+            return mValue;
+        }
+
+    private:
+        friend class RcuSnapshot;
+
+        /** The snapshot that is being read. */
+        const RcuSnapshot& mSnapshot;
+        /** The guard that was the innermost one in this thread before this guard. */
+        const ReadGuard* mPrevious;
+        /** The value obtained when entering the critical section. */
+        const T* mValue;
+        /** Index of the reader counter incremented by this guard. */
+        unsigned int mIndex;
+        /** The innermost read guard of the calling thread, used to detect nested writes. */
+        inline static thread_local const ReadGuard* sInnermost = nullptr;
+    };
+
+    /**
+     * Basic constructor that publishes a default constructed value.
+     */
+    RcuSnapshot() : mCurrent(new T()), mEpoch(0)
+    {
+    }
+
+    /**
+     * Class destructor. It must not be called while any reader is still active.
+     */
+    ~RcuSnapshot()
+    {
+        for (T* value : mRetired)
+        {
+            delete value;
+        }
+        delete mCurrent.load(std::memory_order_relaxed);
+    }
+
+    RcuSnapshot(const RcuSnapshot&) = delete;
+    RcuSnapshot& operator=(const RcuSnapshot&) = delete;
+
+    /**
+     * Publishes a new value and reclaims the previous one once all readers that could
+     * observe it have finished, see exchange and reclaim.
+     *  @param value a new value to publish. The snapshot takes the ownership of it.
+     */
+    void publish(T* value)
+    {
+        exchange(value);
+        reclaim();
+    }
+
+    /**
+     * Publishes a new value without waiting for readers. The previous value is retired
+     * until the next call of reclaim.
+     *  @param value a new value to publish. The snapshot takes the ownership of it.
+     */
+    void exchange(T* value)
+    {
+        T* previous = mCurrent.exchange(value, std::memory_order_seq_cst);
+        ScopedLock lock(mRetiredLock);
+        mRetired.push_back(previous);
+    }
+
+    /**
+     * Waits until all readers that could observe retired values have finished, and deletes them. It
+     * must not be called with a lock that readers may take. If the calling thread is itself
+     * reading this snapshot (e.g. a listener unregistering from within its update), waiting
+     * would dead-lock, so the values stay retired until a later call from another thread.
+     */
+    void reclaim()
+    {
+        if (isReading())
+        {
+            return;
+        }
+        std::vector<T*> retired;
+        {
+            ScopedLock lock(mRetiredLock);
+            retired.swap(mRetired);
+        }
+        {
+            // values retired by this thread may be in the list of another thread, so the grace
+            // period is awaited even if the list is empty. The two epochs tell apart readers of
+            // a single grace period at a time.
+            ScopedLock lock(mSynchroniseLock);
+            synchronise();
+        }
+        for (T* value : retired)
+        {
+            delete value;
+        }
+    }
+
+    /**
+     *  @return true if the calling thread is inside a read-side critical section of this snapshot.
+     */
+    bool isReading() const
+    {
+        for (const ReadGuard* guard = ReadGuard::sInnermost; guard != nullptr; guard = guard->mPrevious)
+        {
+            if (&guard->mSnapshot == this)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    /**
+     * Waits until all readers that started before the call have finished. New readers
+     * are redirected to the other counter before waiting on each one.
+     */
+    void synchronise() const
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            unsigned int index = mEpoch.fetch_add(1, std::memory_order_seq_cst) & 1u;
+            while (mReaders[index].mCount.load(std::memory_order_acquire) != 0)
+            {
+                sched_yield();
+            }
+        }
+    }
+
+    /** Reader counter padded to its own cache line. */
+    struct alignas(64) ReaderCount
+    {
+        std::atomic<int> mCount{0};
+    };
+
+    /** Currently published value. */
+    std::atomic<T*> mCurrent;
+    /** Epoch used to select which reader counter new readers increment. */
+    mutable std::atomic<unsigned int> mEpoch;
+    /** Number of active readers for each epoch parity. */
+    mutable ReaderCount mReaders[2];
+    /** Values replaced since the last grace period. */
+    std::vector<T*> mRetired;
+    /** Protects the list of retired values. */
+    Mutex mRetiredLock;
+    /** Serialises grace periods. */
+    Mutex mSynchroniseLock;
+};
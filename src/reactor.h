@@ -0,0 +1,379 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "generic_thread.h"
+#include "locks.h"
+#include "scoped_lock.h"
+
+
+/**
+ * Receives events of sources served by a Reactor. Handlers are called on the reactor thread,
+ * one at a time, so a handler can keep its state without locking and can call notifyListeners
+ * of a talker to broadcast what it has read.
+ */
+class ReactorHandler
+{
+public:
+    virtual ~ReactorHandler() = default;
+
+    /**
+     * Called when a source is ready.
+     *  @param fd the file descriptor of the source.
+     *  @param events for descriptors added with add(), the epoll events, e.g. EPOLLIN. For timers,
+     *         the number of expirations since the last call. For wake-ups, the number of notifications.
+     */
+    virtual void handleEvents(const int fd, const uint64_t events) = 0;
+};
+
+/**
+ * A thread that serves many event sources with epoll: file descriptors owned by the caller,
+ * timers backed by timerfd, and wake-ups backed by eventfd which other threads raise with
+ * notify(). Ready sources are dispatched to their handlers on the reactor thread, so a few
+ * reactors can replace a thread per source. Sources can be added and removed from any thread,
+ * including handlers. Once remove() returns, the handler of the source is not called anymore.
+ * Handlers must not block, as they delay all other sources of the reactor.
+ */
+class Reactor : public GenericThread<Reactor>
+{
+public:
+    /**
+     * Basic constructor.
+     *  @param maxEvents the maximum number of ready sources collected by a single epoll_wait.
+     */
+    explicit Reactor(const int maxEvents = 64)
+    : GenericThread<Reactor>(), mEpoll(epoll_create1(EPOLL_CLOEXEC)), mWakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      mMaxEvents(maxEvents > 0 ? maxEvents : 1)
+    {
+        if (mEpoll >= 0 && mWakeFd >= 0)
+        {
+            // the internal wake-up is the only source without a handler.
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.ptr = nullptr;
+            epoll_ctl(mEpoll, EPOLL_CTL_ADD, mWakeFd, &event);
+        }
+    }
+
+    /**
+     * Class destructor that stops the reactor and closes timers and wake-ups.
+     */
+    virtual ~Reactor()
+    {
+        stopThread();
+        for (std::pair<const int, std::unique_ptr<Source>>& source : mSources)
+        {
+            if (source.second->mOwned)
+            {
+                close(source.first);
+            }
+        }
+        if (mWakeFd >= 0)
+        {
+            close(mWakeFd);
+        }
+        if (mEpoll >= 0)
+        {
+            close(mEpoll);
+        }
+    }
+
+    /**
+     *  @return true if the epoll instance was created.
+     */
+    inline bool isOpen() const
+    {
+        return mEpoll >= 0 && mWakeFd >= 0;
+    }
+
+    /**
+     * Stops the reactor. Unlike GenericThread::stopThread, it interrupts epoll_wait.
+     *  @param force a flag to indicate if the termination should be forced by cancelling the thread.
+     *  @param[out] threadReturn data returned by the thread. nullptr assumes no return data.
+     */
+    void stopThread(const bool force = false, void* threadReturn = nullptr)
+    {
+        requestStop();
+        notify(mWakeFd);
+        GenericThread<Reactor>::stopThread(force, threadReturn);
+    }
+
+    /**
+     * Adds a file descriptor owned by the caller. It has to stay open until it is removed and
+     * should be non-blocking, so that its handler can read until EAGAIN without stalling the reactor.
+     *  @param fd the file descriptor.
+     *  @param events the epoll events to wait for, e.g. EPOLLIN, optionally with EPOLLET.
+     *  @param handler the handler of the events, it must stay valid until the descriptor is removed.
+     *  @return false if the descriptor could not be added.
+     */
+    bool add(const int fd, const uint32_t events, ReactorHandler* handler)
+    {
+        return addSource(fd, events, handler, Source::DESCRIPTOR);
+    }
+
+    /**
+     * Changes the events a file descriptor added with add() waits for.
+     *  @param fd the file descriptor.
+     *  @param events the epoll events to wait for.
+     *  @return false if the descriptor was not added or could not be modified.
+     */
+    bool modify(const int fd, const uint32_t events)
+    {
+        ScopedLock lock(mLock);
+        std::unordered_map<int, std::unique_ptr<Source>>::iterator source = mSources.find(fd);
+        if (mSources.end() == source || Source::DESCRIPTOR != source->second->mKind)
+        {
+            return false;
+        }
+        epoll_event event = {};
+        event.events = events;
+        event.data.ptr = source->second.get();
+        return 0 == epoll_ctl(mEpoll, EPOLL_CTL_MOD, fd, &event);
+    }
+
+    /**
+     * Adds a timer on CLOCK_MONOTONIC. The reactor owns its file descriptor.
+     *  @param handler the handler of expirations, it must stay valid until the timer is removed.
+     *  @param delay the time to the first expiration in nanoseconds, must be positive.
+     *  @param period the period of the following expirations in nanoseconds, 0 for a single expiration.
+     *  @return the file descriptor of the timer, or -1 on failure.
+     */
+    int addTimer(ReactorHandler* handler, const int64_t delay, const int64_t period = 0)
+    {
+        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (fd >= 0 && !(setTimer(fd, delay, period) && addSource(fd, EPOLLIN, handler, Source::TIMER)))
+        {
+            close(fd);
+            fd = -1;
+        }
+        return fd;
+    }
+
+    /**
+     * Re-arms or disarms a timer.
+     *  @param fd the file descriptor of the timer.
+     *  @param delay the time to the next expiration in nanoseconds, 0 to disarm the timer.
+     *  @param period the period of the following expirations in nanoseconds, 0 for a single expiration.
+     *  @return false if the timer could not be set.
+     */
+    bool setTimer(const int fd, const int64_t delay, const int64_t period = 0)
+    {
+        itimerspec spec = {toTimespec(period), toTimespec(delay)};
+        return 0 == timerfd_settime(fd, 0, &spec, nullptr);
+    }
+
+    /**
+     * Adds a wake-up, which other threads raise with notify() to have its handler called on
+     * the reactor thread. Notifications raised before the handler runs are coalesced. The
+     * reactor owns its file descriptor.
+     *  @param handler the handler of notifications, it must stay valid until the wake-up is removed.
+     *  @return the file descriptor of the wake-up, or -1 on failure.
+     */
+    int addWakeup(ReactorHandler* handler)
+    {
+        int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd >= 0 && !addSource(fd, EPOLLIN, handler, Source::WAKEUP))
+        {
+            close(fd);
+            fd = -1;
+        }
+        return fd;
+    }
+
+    /**
+     * Raises a wake-up. Can be called from any thread and never blocks.
+     *  @param fd the file descriptor of the wake-up.
+     *  @return false if the wake-up could not be raised.
+     */
+    inline bool notify(const int fd) const
+    {
+        const uint64_t one = 1;
+        return sizeof(one) == write(fd, &one, sizeof(one));
+    }
+
+    /**
+     * Removes a source and closes its file descriptor if the reactor owns it. If called from
+     * another thread while the reactor dispatches events, waits until the dispatch finishes.
+     *  @param fd the file descriptor of the source.
+     *  @return false if there is no such source.
+     */
+    bool remove(const int fd)
+    {
+        // handlers are called under the dispatch lock, which the reactor thread already holds.
+        std::optional<ScopedLock<Mutex>> dispatchLock;
+        if (this != sCurrent)
+        {
+            dispatchLock.emplace(mDispatchLock);
+        }
+        ScopedLock lock(mLock);
+        std::unordered_map<int, std::unique_ptr<Source>>::iterator source = mSources.find(fd);
+        if (mSources.end() == source)
+        {
+            return false;
+        }
+        epoll_ctl(mEpoll, EPOLL_CTL_DEL, fd, nullptr);
+        if (source->second->mOwned)
+        {
+            close(fd);
+        }
+        // events already collected may still point to the source, so it is freed after the dispatch.
+        source->second->mHandler = nullptr;
+        mRetired.push_back(std::move(source->second));
+        mSources.erase(source);
+        return true;
+    }
+
+    /**
+     * Dispatches ready sources until the reactor is stopped.
+     */
+    void* threadBody()
+    {
+        std::vector<epoll_event> events(static_cast<size_t>(mMaxEvents));
+        sCurrent = this;
+        while (isRunning())
+        {
+            int ready = epoll_wait(mEpoll, events.data(), mMaxEvents, -1);
+            ScopedLock dispatchLock(mDispatchLock);
+            for (int i = 0; i < ready; ++i)
+            {
+                dispatch(events[static_cast<size_t>(i)]);
+            }
+            ScopedLock lock(mLock);
+            mRetired.clear();
+        }
+        sCurrent = nullptr;
+        return nullptr;
+    }
+
+private:
+    /**
+     * A source served by the reactor.
+     */
+    struct Source
+    {
+        enum Kind
+        {
+            DESCRIPTOR,
+            TIMER,
+            WAKEUP
+        };
+
+        /** The file descriptor. */
+        int mFd;
+        /** The kind of the source. */
+        Kind mKind;
+        /** True if the reactor closes the descriptor. */
+        bool mOwned;
+        /** The handler, nullptr once the source was removed. */
+        ReactorHandler* mHandler;
+    };
+
+    /**
+     * Registers a source with epoll.
+     *  @return false if the source could not be added.
+     */
+    bool addSource(const int fd, const uint32_t events, ReactorHandler* handler, const Source::Kind kind)
+    {
+        ScopedLock lock(mLock);
+        if (nullptr == handler || mSources.end() != mSources.find(fd))
+        {
+            return false;
+        }
+        std::unique_ptr<Source> source(new Source{fd, kind, Source::DESCRIPTOR != kind, handler});
+        epoll_event event = {};
+        event.events = events;
+        event.data.ptr = source.get();
+        if (0 != epoll_ctl(mEpoll, EPOLL_CTL_ADD, fd, &event))
+        {
+            return false;
+        }
+        mSources[fd] = std::move(source);
+        return true;
+    }
+
+    /**
+     * Calls the handler of a ready source. Timers and wake-ups are read first, so they do not
+     * stay ready, and their handlers receive the number of expirations or notifications.
+     *  @param event the event returned by epoll_wait.
+     */
+    void dispatch(const epoll_event& event)
+    {
+        Source* source = static_cast<Source*>(event.data.ptr);
+        uint64_t count = 0;
+        if (nullptr == source)
+        {
+            if (sizeof(count) != read(mWakeFd, &count, sizeof(count)))
+            {
+                // another dispatch already read the counter.
+            }
+        }
+        else if (nullptr != source->mHandler)
+        {
+            if (Source::DESCRIPTOR == source->mKind)
+            {
+                source->mHandler->handleEvents(source->mFd, event.events);
+            }
+            else if (sizeof(count) == read(source->mFd, &count, sizeof(count)))
+            {
+                source->mHandler->handleEvents(source->mFd, count);
+            }
+        }
+    }
+
+    /**
+     *  @param nanoseconds a duration in nanoseconds.
+     *  @return the duration as timespec.
+     */
+    static inline timespec toTimespec(const int64_t nanoseconds)
+    {
+        return {static_cast<time_t>(nanoseconds / 1000000000), static_cast<long>(nanoseconds % 1000000000)};
+    }
+
+    /** The epoll instance. */
+    const int mEpoll;
+    /** Internal eventfd that interrupts epoll_wait when the reactor is being stopped. */
+    const int mWakeFd;
+    /** The maximum number of events returned by a single epoll_wait. */
+    const int mMaxEvents;
+    /** Held by the reactor thread while it calls handlers. */
+    Mutex mDispatchLock;
+    /** Protects the sources. */
+    Mutex mLock;
+    /** Sources by their file descriptors. */
+    std::unordered_map<int, std::unique_ptr<Source>> mSources;
+    /** Removed sources waiting for the end of the current dispatch. */
+    std::vector<std::unique_ptr<Source>> mRetired;
+    /** The reactor running on the calling thread, if any. */
+    inline static thread_local const Reactor* sCurrent = nullptr;
+};
@@ -22,9 +22,12 @@
 
 #pragma once
 
-#include <algorithm>
+#include <atomic>
+#include <string>
+#include <unordered_map>
 #include <vector>
-#include "scoped_lock.h"
+#include "locks.h"
+#include "metrics.h"
 
 
 /**
@@ -32,72 +35,380 @@
  * and vice versa. This enables for talker to register to listeners, or for listener to register
  * to talkers. As internally pointers to RegisterTo are stored in a vector, when the class goes
  * out of scope, it will notify all RegisterTo instances to remove itself from their respective
- * lists.
+ * lists. A hash map of positions in the vector makes registration and unregistration constant
+ * time, so that talkers with thousands of listeners can be built and torn down quickly. Items
+ * keep the order in which they registered: a removed item leaves a gap that is closed by a later
+ * registration or unregistration, but never while the list is being iterated, so that items
+ * can unregister each other from within a broadcast.
+ * The list is protected by a lock policy from locks.h; the handshake never takes the lock of
+ * one side twice, so non-recursive policies can be used as well.
  */
-template<typename Derived, typename RegisterTo>
+template<typename Derived, typename RegisterTo, typename Lock = RecursiveMutex>
 class RegistrationBase
 {
 public:
     /**
-     * Constructor which initialises recursive mutex.
+     * Basic constructor.
      */
     RegistrationBase()
     {
-        pthread_mutexattr_t attr;
-        pthread_mutexattr_init(&attr);
-        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
-        pthread_mutex_init(&mLock, &attr);
     }
 
-
     /**
      * Restructor that unregisters all RegisterTo instances from itself.
      */
     virtual ~RegistrationBase()
     {
-        for (RegisterTo* item : mItems)
-        {
-            item->unregisterFrom(static_cast<Derived*>(this));
-        }
-        pthread_mutex_destroy(&mLock);
+        unregisterAll();
     }
 
     /**
      * Registers an item to this class. Registration is done only 
-     * if the @p item was not already registered.
+     * if the @p item was not already registered. Takes constant time on average.
      *  @param item a pointer to either talker or listener.
      */
     void registerTo(RegisterTo* item)
     {
-        ScopedLock lock(mLock);
-        if (std::find(mItems.begin(), mItems.end(), item) == mItems.end())
         {
-            mItems.push_back(item);
-            // handshake. Make sure item knows we are registering.
-            item->registerTo(static_cast<Derived*>(this));
+            ItemsLock lock(*this);
+            registerLocked(item);
         }
+        locksReleased();
+        item->release();
     }
 
     /**
      * Unregisters an item from this class. Unregistration is done only if
-     * the @p item was already registered.
+     * the @p item was already registered. Takes constant time on average and keeps the order
+     * of the remaining items. Once it returns, talkers in the snapshot or concurrent modes do not
+     * update the listener anymore, except when it is called from within an update of that
+     * listener: the talker cannot wait for its own broadcast then, so broadcasts of other
+     * threads that are already in progress may still update the listener after it returns.
      *  @param item a pointer to either talker or listener.
      */
     void unregisterFrom(RegisterTo* item)
     {
-        ScopedLock lock(mLock);
-        auto it = std::find(mItems.begin(), mItems.end(), item);
-        if (it != mItems.end())
         {
-            mItems.erase(it);
-            // handshake. Make sure item knows we are unregistering.
-            item->unregisterFrom(static_cast<Derived*>(this));
+            ItemsLock lock(*this);
+            if (remove(item))
+            {
+                // handshake. Make sure item knows we are unregistering.
+                item->detach(static_cast<Derived*>(this));
+            }
+        }
+        locksReleased();
+        item->release();
+    }
+
+    /**
+     * Unregisters all items from this class.
+     */
+    void unregisterAll()
+    {
+        std::vector<RegisterTo*> removed;
+        {
+            ItemsLock lock(*this);
+            for (typename std::vector<RegisterTo*>::const_reverse_iterator it = mItems.rbegin(); it != mItems.rend(); ++it)
+            {
+                if (nullptr != *it)
+                {
+                    removed.push_back(*it);
+                }
+            }
+            for (RegisterTo* item : removed)
+            {
+                remove(item);
+                item->detach(static_cast<Derived*>(this));
+            }
+        }
+        locksReleased();
+        for (RegisterTo* item : removed)
+        {
+            item->release();
         }
     }
 
+    /**
+     * Sets the name under which metrics of this class are reported. Does nothing if metrics
+     * are compiled out.
+     *  @param label a human readable name.
+     */
+    void setMetricsLabel(const std::string& label)
+    {
+#ifdef UTILS_ENABLE_METRICS
+        mMetrics.setLabel(label);
+#else
+        (void)label;
+#endif
+    }
+
 protected:
-    /** The list of items registered to this class. */
+    /**
+     * Locks the list of items for its lifetime. With metrics enabled, time spent waiting
+     * for the lock is recorded; an uncontended lock is recorded as zero without reading the clock.
+     */
+    class ItemsLock
+    {
+    public:
+        /**
+         * Basic constructor that locks the list of items of @p owner.
+         *  @param owner the class whose list is locked.
+         */
+        explicit ItemsLock(const RegistrationBase& owner) : mLock(owner.mLock)
+        {
+#ifdef UTILS_ENABLE_METRICS
+            if (mLock.tryLock())
+            {
+                owner.mMetrics.mLockWait.record(0);
+            }
+            else
+            {
+                const int64_t start = monotonicNow();
+                mLock.lock();
+                owner.mMetrics.mLockWait.record(monotonicNow() - start);
+            }
+#else
+            mLock.lock();
+#endif
+        }
+
+        /**
+         * Basic destructor, unlocks the list.
+         */
+        ~ItemsLock()
+        {
+            mLock.unlock();
+        }
+
+        ItemsLock(const ItemsLock&) = delete;
+        ItemsLock& operator=(const ItemsLock&) = delete;
+
+    private:
+        /** The locked lock. */
+        Lock& mLock;
+    };
+
+    /**
+     * Marks the list of items as being iterated for its lifetime, so that items removed in the
+     * meantime leave nullptr in their places instead of moving the remaining items. The lock
+     * has to be held when it is created.
+     */
+    class ItemsIteration
+    {
+    public:
+        /**
+         * Basic constructor that marks the list of items of @p owner as being iterated.
+         *  @param owner the class whose list is iterated.
+         */
+        explicit ItemsIteration(const RegistrationBase& owner) : mOwner(owner)
+        {
+            mOwner.mIterations.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * Basic destructor, ends the iteration.
+         */
+        ~ItemsIteration()
+        {
+            mOwner.mIterations.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        ItemsIteration(const ItemsIteration&) = delete;
+        ItemsIteration& operator=(const ItemsIteration&) = delete;
+
+    private:
+        /** The class whose list is iterated. */
+        const RegistrationBase& mOwner;
+    };
+
+    /**
+     * Registers an item with the lock already held.
+     *  @param item a pointer to either talker or listener.
+     *  @return false if the item was already registered.
+     */
+    bool registerLocked(RegisterTo* item)
+    {
+        if (!add(item))
+        {
+            return false;
+        }
+        // handshake. Make sure item knows we are registering.
+        item->attach(static_cast<Derived*>(this));
+        return true;
+    }
+
+    /**
+     * Gives the registered items in the order they registered. The lock has to be held.
+     *  @return the list of items, with nullptr in places of removed items that were not closed yet.
+     */
+    const std::vector<RegisterTo*>& items() const
+    {
+        return mItems;
+    }
+
+    /**
+     * Gives the number of registered items. The lock has to be held.
+     *  @return the number of items in items() that are not nullptr.
+     */
+    size_t itemCount() const
+    {
+        return mItems.size() - mRemoved;
+    }
+
+    /**
+     * Checks if the list of items is being iterated. The lock has to be held.
+     *  @return true while an ItemsIteration exists.
+     */
+    bool isIterating() const
+    {
+        return 0 != mIterations.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Called with the lock held every time the list of items changes. Derived classes
+     * can override it to keep their own view of the registered items up to date.
+     */
+    virtual void itemsChanged()
+    {
+    }
+
+    /**
+     * Called with the lock held when an item is removed, right before itemsChanged. Derived
+     * classes can override it to drop their own data about the item.
+     *  @param item the removed item.
+     */
+    virtual void itemRemoved(RegisterTo* item)
+    {
+        (void)item;
+    }
+
+    /**
+     * Called on both sides of a registration or unregistration once neither side holds its
+     * lock anymore. Derived classes can override it to finish work that must not be done
+     * under the locks, e.g. joining a thread that may need them.
+     */
+    virtual void locksReleased()
+    {
+    }
+
+    /** The list of items registered to this class, in the order they registered, with nullptr in
+     *  place of removed items until the gaps are closed. */
     std::vector<RegisterTo*> mItems;
+    /** Positions of items in mItems. */
+    std::unordered_map<RegisterTo*, size_t> mIndices;
+    /** Number of removed items whose places in mItems are still empty. */
+    size_t mRemoved = 0;
+    /** The number of iterations over mItems in progress. */
+    mutable std::atomic<int> mIterations{0};
     /** Lock for accessing the list of items. */
-    mutable pthread_mutex_t mLock;
+    mutable Lock mLock;
+#ifdef UTILS_ENABLE_METRICS
+    /** Metrics of this class. */
+    mutable ObjectMetrics mMetrics{this};
+#endif
+
+private:
+    /** The other side of the handshake calls attach and detach. */
+    template<typename, typename, typename>
+    friend class RegistrationBase;
+
+    /**
+     * Adds an item to the list. The lock has to be held.
+     *  @param item a pointer to either talker or listener.
+     *  @return false if the item was already registered.
+     */
+    bool add(RegisterTo* item)
+    {
+        if (!mIndices.emplace(item, mItems.size()).second)
+        {
+            return false;
+        }
+        mItems.push_back(item);
+        compact();
+        itemsChanged();
+        return true;
+    }
+
+    /**
+     * Removes an item from the list, leaving an empty place that is closed later. The lock has to be held.
+     *  @param item a pointer to either talker or listener.
+     *  @return false if the item was not registered.
+     */
+    bool remove(RegisterTo* item)
+    {
+        auto it = mIndices.find(item);
+        if (it == mIndices.end())
+        {
+            return false;
+        }
+        mItems[it->second] = nullptr;
+        mIndices.erase(it);
+        ++mRemoved;
+        compact();
+        itemRemoved(item);
+        itemsChanged();
+        return true;
+    }
+
+    /**
+     * Closes the empty places left by removed items unless the list is being iterated. Empty
+     * places at the end are dropped right away, the others once they make up half of the list,
+     * so that a run of removals costs a single pass in total. The lock has to be held.
+     */
+    void compact()
+    {
+        if (isIterating())
+        {
+            return;
+        }
+        while (!mItems.empty() && nullptr == mItems.back())
+        {
+            mItems.pop_back();
+            --mRemoved;
+        }
+        if (0 == mRemoved || 2 * mRemoved < mItems.size())
+        {
+            return;
+        }
+        size_t next = 0;
+        for (RegisterTo* item : mItems)
+        {
+            if (nullptr != item)
+            {
+                mIndices[item] = next;
+                mItems[next++] = item;
+            }
+        }
+        mItems.resize(next);
+        mRemoved = 0;
+    }
+
+    /**
+     * Second half of the handshake: adds an item that has just registered this class,
+     * without calling it back, so that no lock is taken twice by the same thread.
+     *  @param item a pointer to either talker or listener.
+     */
+    void attach(RegisterTo* item)
+    {
+        ItemsLock lock(*this);
+        add(item);
+    }
+
+    /**
+     * Lets the other side of the handshake know that the locks were released.
+     */
+    void release()
+    {
+        locksReleased();
+    }
+
+    /**
+     * Second half of the handshake: removes an item that has just unregistered this class.
+     *  @param item a pointer to either talker or listener.
+     */
+    void detach(RegisterTo* item)
+    {
+        ItemsLock lock(*this);
+        remove(item);
+    }
 };
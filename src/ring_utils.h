@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+/**
+ * Helpers shared by the lock-free rings of the library: power-of-two capacities, so that an
+ * index maps to a slot with a mask, and seqlocks, which let readers copy a slot without locking
+ * and detect that a writer overwrote it meanwhile.
+ */
+
+/**
+ *  @param value a value to round up.
+ *  @return the smallest power of two not lower than @p value.
+ */
+inline size_t roundUpToPowerOfTwo(const size_t value)
+{
+    size_t result = 1;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+/**
+ * Packs trivially copyable arguments one after another into 64-bit words, the storage of a
+ * seqlock. Relaxed atomic words let readers and a writer access the same slot without racing on
+ * plain memory.
+ */
+template<typename... Args>
+struct SeqlockWords
+{
+    /** The number of words needed to store all arguments one after another. */
+    static constexpr size_t COUNT = ((sizeof(Args) + ... + 0) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    /**
+     * Copies arguments into words.
+     *  @param[out] words at least COUNT words, unused bytes are cleared.
+     *  @param args the arguments to pack.
+     */
+    static void pack(uint64_t* words, const Args&... args)
+    {
+        memset(words, 0, COUNT * sizeof(uint64_t));
+        size_t offset = 0;
+        ((memcpy(reinterpret_cast<char*>(words) + offset, &args, sizeof(Args)), offset += sizeof(Args)), ...);
+    }
+
+    /**
+     * Copies arguments out of words.
+     *  @param words COUNT words filled by pack.
+     *  @param[out] args the unpacked arguments.
+     */
+    static void unpack(const uint64_t* words, Args&... args)
+    {
+        size_t offset = 0;
+        ((memcpy(&args, reinterpret_cast<const char*>(words) + offset, sizeof(Args)), offset += sizeof(Args)), ...);
+    }
+};
+
+/**
+ * Writes words guarded by a sequence number. Only one thread may write at a time.
+ *  @param sequence the sequence number of the words.
+ *  @param writing an odd sequence number that marks the write as in progress.
+ *  @param written an even sequence number that publishes the write.
+ *  @param[out] words the guarded words.
+ *  @param values the values to write.
+ *  @param count the number of words.
+ */
+inline void seqlockWrite(std::atomic<uint64_t>& sequence, const uint64_t writing, const uint64_t written,
+                         std::atomic<uint64_t>* words, const uint64_t* values, const size_t count)
+{
+    sequence.store(writing, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < count; ++i)
+    {
+        words[i].store(values[i], std::memory_order_relaxed);
+    }
+    sequence.store(written, std::memory_order_release);
+}
+
+/**
+ * Makes one attempt to read words guarded by a sequence number.
+ *  @param sequence the sequence number of the words.
+ *  @param words the guarded words.
+ *  @param[out] values the values read, may be torn if false is returned.
+ *  @param count the number of words.
+ *  @param[out] version the even sequence number the values were written with.
+ *  @return false if a write was in progress or finished during the read.
+ */
+inline bool seqlockRead(const std::atomic<uint64_t>& sequence, const std::atomic<uint64_t>* words, uint64_t* values,
+                        const size_t count, uint64_t& version)
+{
+    version = sequence.load(std::memory_order_acquire);
+    if (0 != (version & 1u))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        values[i] = words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version == sequence.load(std::memory_order_relaxed);
+}
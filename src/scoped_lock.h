@@ -23,9 +23,47 @@
 #pragma once
 
 #include <pthread.h>
+#include "locks.h"
 
+/**
+ * Locks a lock policy, see locks.h, for the lifetime of the object. The type of the lock is
+ * deduced from the constructor argument.
+ */
+template<typename Lock>
 class ScopedLock
 {
+public:
+    /**
+     * Basic constructor, takes reference to a lock and locks it.
+     *  @param lock a reference to a lock.
+     */
+    explicit ScopedLock(Lock& lock) : mLock(lock)
+    {
+        mLock.lock();
+    }
+
+    /**
+     * Basic destructor, unlocks the lock.
+     */
+    ~ScopedLock()
+    {
+        mLock.unlock();
+    }
+
+    ScopedLock(const ScopedLock&) = delete;
+    ScopedLock& operator=(const ScopedLock&) = delete;
+
+private:
+    /** Reference to the lock that will be locked by this class. */
+    Lock& mLock;
+};
+
+/**
+ * Locks a raw pthread mutex.
+ */
+template<>
+class ScopedLock<pthread_mutex_t>
+{
 public:
     /**
      * Basic constructor, takes reference to a mutex and locks it.
@@ -0,0 +1,429 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <time.h>
+#include <type_traits>
+#include <unistd.h>
+#include "generic_listener.h"
+#include "generic_talker.h"
+#include "generic_thread.h"
+
+
+/**
+ * Layout of the beginning of a shared-memory ring, followed by the slots. All fields are
+ * lock-free atomics, which are address-free and can therefore be shared between processes.
+ */
+struct ShmRingHeader
+{
+    /** The maximum number of receivers attached to one ring. */
+    static constexpr int MAX_READERS = 16;
+    /** Value written last by the publisher once the ring is initialised. */
+    static constexpr uint32_t MAGIC = 0x53484d52;
+    /** Process id of a cursor that is being attached. */
+    static constexpr int32_t RESERVED = -1;
+
+    /** Read position of one receiver. */
+    struct alignas(64) Cursor
+    {
+        /** Process id of the receiver, 0 if the cursor is free and RESERVED while attaching. */
+        std::atomic<int32_t> mPid;
+        /** Index of the next slot the receiver will read. */
+        std::atomic<uint64_t> mHead;
+    };
+
+    /** Equal to MAGIC once the publisher has initialised the ring. */
+    std::atomic<uint32_t> mMagic;
+    /** Size of a single payload, checked by receivers. */
+    uint64_t mSlotSize;
+    /** Number of slots. */
+    uint64_t mCapacity;
+    /** Index of the next slot to be written by the publisher. */
+    alignas(64) std::atomic<uint64_t> mTail;
+    /** Futex word incremented on every publish. */
+    alignas(64) std::atomic<uint32_t> mSequence;
+    /** Number of receivers sleeping on the futex, so the publisher can skip the wake-up system call. */
+    std::atomic<uint32_t> mWaiters;
+    /** Number of payloads dropped because a receiver was too slow. */
+    alignas(64) std::atomic<uint64_t> mDropped;
+    Cursor mCursors[MAX_READERS];
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+                  "Shared-memory rings require lock-free atomics");
+
+    /**
+     *  @param capacity the number of slots.
+     *  @param slotSize the size of a single slot.
+     *  @return the size of the whole shared-memory segment.
+     */
+    static size_t getSegmentSize(const uint64_t capacity, const size_t slotSize)
+    {
+        return sizeof(ShmRingHeader) + capacity * slotSize;
+    }
+
+    /**
+     * Calls the futex system call on a word shared between processes.
+     */
+    static long futex(std::atomic<uint32_t>* address, const int operation, const uint32_t value, const timespec* timeout)
+    {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(address), operation, value, timeout, nullptr, 0);
+    }
+};
+
+/**
+ * Publishes trivially copyable payloads into a POSIX shared-memory ring that receivers in other
+ * processes read with ShmReceiver. It is a listener, so it can be registered to a talker to bridge
+ * its output to other processes, or used directly through publish(). The publisher never blocks:
+ * if the slowest receiver has not consumed the oldest slot yet, the payload is dropped and counted.
+ * The publisher owns the name of the segment: it removes an existing segment of that name, e.g.
+ * left behind by a crashed publisher, before creating its own, and removes the name when destroyed.
+ * A publisher and receivers still using a removed segment keep it mapped and are not disturbed,
+ * but new receivers attach to the new one. Only one publisher per name should therefore exist.
+ * Lock is the lock of the talkers feeding the publisher.
+ */
+template<typename Lock, typename T>
+class BasicShmPublisher : public BasicListener<Lock, T>
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Shared-memory payloads must be trivially copyable");
+
+public:
+    /**
+     * Basic constructor that creates and maps the shared-memory segment.
+     *  @param name the name of the segment, e.g. "/jetracer_imu".
+     *  @param capacity the number of payloads the ring can hold.
+     */
+    BasicShmPublisher(const std::string& name, const uint64_t capacity) : BasicListener<Lock, T>(), mName(name), mHeader(nullptr), mSlots(nullptr), mSize(0)
+    {
+        // a fresh segment is created, so that the header of a ring still in use is never reset.
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd >= 0)
+        {
+            mSize = ShmRingHeader::getSegmentSize(capacity, sizeof(T));
+            if (0 == ftruncate(fd, static_cast<off_t>(mSize)))
+            {
+                void* memory = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (MAP_FAILED != memory)
+                {
+                    memset(memory, 0, sizeof(ShmRingHeader));
+                    mHeader = static_cast<ShmRingHeader*>(memory);
+                    mSlots = reinterpret_cast<T*>(static_cast<char*>(memory) + sizeof(ShmRingHeader));
+                    mHeader->mSlotSize = sizeof(T);
+                    mHeader->mCapacity = capacity;
+                    mHeader->mMagic.store(ShmRingHeader::MAGIC, std::memory_order_release);
+                }
+            }
+            close(fd);
+        }
+    }
+
+    /**
+     * Class destructor that unmaps and removes the segment. Receivers keep their mapping.
+     */
+    virtual ~BasicShmPublisher()
+    {
+        this->unregisterAll();
+        if (nullptr != mHeader)
+        {
+            munmap(mHeader, mSize);
+            shm_unlink(mName.c_str());
+        }
+    }
+
+    /**
+     *  @return true if the segment was created.
+     */
+    inline bool isOpen() const
+    {
+        return nullptr != mHeader;
+    }
+
+    /**
+     * Copies the payload into the ring and wakes up sleeping receivers.
+     *  @param data the payload to publish.
+     *  @return false if the payload was dropped because a receiver was too slow.
+     */
+    bool publish(const T& data)
+    {
+        if (nullptr == mHeader)
+        {
+            return false;
+        }
+        uint64_t tail = mHeader->mTail.load(std::memory_order_relaxed);
+        if (tail - getSlowestHead(tail) >= mHeader->mCapacity)
+        {
+            mHeader->mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        memcpy(&mSlots[tail % mHeader->mCapacity], &data, sizeof(T));
+        mHeader->mTail.store(tail + 1, std::memory_order_release);
+        mHeader->mSequence.fetch_add(1, std::memory_order_seq_cst);
+        if (0 != mHeader->mWaiters.load(std::memory_order_seq_cst))
+        {
+            ShmRingHeader::futex(&mHeader->mSequence, FUTEX_WAKE, INT_MAX, nullptr);
+        }
+        return true;
+    }
+
+    /**
+     * Publishes the update of a talker this publisher is registered to.
+     *  @param data a new data broadcasted by a talker.
+     */
+    void update(const T& data) override
+    {
+        if (!publish(data))
+        {
+            this->countDropped();
+        }
+    }
+
+    /**
+     *  @return the number of receivers attached to the ring.
+     */
+    int getReaderCount() const
+    {
+        int count = 0;
+        for (int i = 0; nullptr != mHeader && i < ShmRingHeader::MAX_READERS; ++i)
+        {
+            count += (mHeader->mCursors[i].mPid.load(std::memory_order_acquire) > 0) ? 1 : 0;
+        }
+        return count;
+    }
+
+    /**
+     *  @return the number of payloads dropped because a receiver was too slow.
+     */
+    inline uint64_t getDropped() const
+    {
+        return nullptr != mHeader ? mHeader->mDropped.load(std::memory_order_relaxed) : 0;
+    }
+
+private:
+    /**
+     * Finds the read position of the slowest receiver. Cursors of receivers whose process no
+     * longer exists are released, so a crashed receiver does not stall the ring forever.
+     *  @param tail the current write position.
+     *  @return the lowest read position, or @p tail if there are no receivers.
+     */
+    uint64_t getSlowestHead(const uint64_t tail)
+    {
+        uint64_t slowest = tail;
+        for (ShmRingHeader::Cursor& cursor : mHeader->mCursors)
+        {
+            int32_t pid = cursor.mPid.load(std::memory_order_acquire);
+            if (pid > 0)
+            {
+                uint64_t head = cursor.mHead.load(std::memory_order_acquire);
+                if (tail - head >= mHeader->mCapacity && 0 != kill(pid, 0) && ESRCH == errno)
+                {
+                    cursor.mPid.compare_exchange_strong(pid, 0, std::memory_order_acq_rel);
+                    continue;
+                }
+                slowest = head < slowest ? head : slowest;
+            }
+        }
+        return slowest;
+    }
+
+    /** The name of the segment. */
+    std::string mName;
+    /** The mapped header of the ring. */
+    ShmRingHeader* mHeader;
+    /** The mapped slots of the ring. */
+    T* mSlots;
+    /** The size of the mapping. */
+    size_t mSize;
+};
+
+/**
+ * Shared-memory publisher with the lock selected by LockPolicy.
+ */
+template<typename T>
+using ShmPublisher = BasicShmPublisher<typename LockPolicy<T>::Type, T>;
+
+/**
+ * Receives payloads published by a ShmPublisher in another process and broadcasts them to its
+ * listeners from its own thread. Listeners get a reference to the payload inside the shared
+ * memory, so nothing is copied on the receiving side; the slot is handed back to the publisher
+ * only after all listeners returned, so they must not keep the reference past update. When the
+ * ring is empty the thread sleeps on a futex shared with the publisher.
+ */
+template<typename T>
+class ShmReceiver : public GenericTalker<T>, public GenericThread<ShmReceiver<T>>
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Shared-memory payloads must be trivially copyable");
+
+public:
+    /**
+     * Basic constructor that maps an existing segment, attaches to it and starts receiving.
+     * A segment whose publisher has not finished creating it is treated as not existing yet.
+     *  @param name the name of the segment used by the publisher.
+     *  @param listener a listener registered before the receiver attaches, so that it gets the
+     *         first payload published after attaching; nullptr for none.
+     */
+    explicit ShmReceiver(const std::string& name, GenericListener<T>* listener = nullptr)
+    : GenericTalker<T>(), GenericThread<ShmReceiver<T>>(), mHeader(nullptr), mSlots(nullptr), mCursor(nullptr), mSize(0)
+    {
+        if (nullptr != listener)
+        {
+            this->registerTo(listener);
+        }
+        int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        struct stat status;
+        if (fd >= 0 && 0 == fstat(fd, &status) && static_cast<size_t>(status.st_size) >= sizeof(ShmRingHeader))
+        {
+            // reading the mapping beyond the size of the segment would raise SIGBUS.
+            void* memory = mmap(nullptr, sizeof(ShmRingHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (MAP_FAILED != memory)
+            {
+                ShmRingHeader* header = static_cast<ShmRingHeader*>(memory);
+                bool valid = ShmRingHeader::MAGIC == header->mMagic.load(std::memory_order_acquire) && sizeof(T) == header->mSlotSize;
+                mSize = ShmRingHeader::getSegmentSize(header->mCapacity, sizeof(T));
+                valid = valid && static_cast<size_t>(status.st_size) >= mSize;
+                munmap(memory, sizeof(ShmRingHeader));
+                memory = valid ? mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+            }
+            if (MAP_FAILED != memory)
+            {
+                mHeader = static_cast<ShmRingHeader*>(memory);
+                mSlots = reinterpret_cast<const T*>(static_cast<char*>(memory) + sizeof(ShmRingHeader));
+                attach();
+            }
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        if (nullptr != mCursor)
+        {
+            this->startThread();
+        }
+    }
+
+    /**
+     * Class destructor that stops receiving, detaches from the ring and unmaps it.
+     */
+    virtual ~ShmReceiver()
+    {
+        this->requestStop();
+        if (nullptr != mHeader)
+        {
+            // a changed sequence makes a futex wait that is about to start return at once.
+            mHeader->mSequence.fetch_add(1, std::memory_order_seq_cst);
+            ShmRingHeader::futex(&mHeader->mSequence, FUTEX_WAKE, INT_MAX, nullptr);
+        }
+        this->stopThread();
+        if (nullptr != mCursor)
+        {
+            mCursor->mPid.store(0, std::memory_order_release);
+        }
+        if (nullptr != mHeader)
+        {
+            munmap(mHeader, mSize);
+        }
+    }
+
+    /**
+     *  @return true if the receiver is attached to a ring.
+     */
+    inline bool isOpen() const
+    {
+        return nullptr != mCursor;
+    }
+
+    /**
+     * Broadcasts payloads as they arrive until the receiver is destroyed.
+     */
+    void* threadBody()
+    {
+        uint64_t head = mCursor->mHead.load(std::memory_order_relaxed);
+        while (true)
+        {
+            uint32_t sequence = mHeader->mSequence.load(std::memory_order_seq_cst);
+            // checked after the sequence is read, so a stop requested later changes the sequence the wait expects.
+            if (!this->isRunning())
+            {
+                break;
+            }
+            uint64_t tail = mHeader->mTail.load(std::memory_order_acquire);
+            if (head == tail)
+            {
+                mHeader->mWaiters.fetch_add(1, std::memory_order_seq_cst);
+                // the publisher changes the sequence after each publish, so the wait returns at once if anything arrived meanwhile.
+                ShmRingHeader::futex(&mHeader->mSequence, FUTEX_WAIT, sequence, nullptr);
+                mHeader->mWaiters.fetch_sub(1, std::memory_order_seq_cst);
+                continue;
+            }
+            for (; head != tail; ++head)
+            {
+                this->notifyListeners(mSlots[head % mHeader->mCapacity]);
+                mCursor->mHead.store(head + 1, std::memory_order_release);
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    /**
+     * Takes a free cursor and starts reading from the current write position.
+     */
+    void attach()
+    {
+        for (ShmRingHeader::Cursor& cursor : mHeader->mCursors)
+        {
+            // reserve the cursor first, so the publisher ignores it until its position is set.
+            int32_t expected = 0;
+            if (cursor.mPid.compare_exchange_strong(expected, ShmRingHeader::RESERVED, std::memory_order_acq_rel))
+            {
+                cursor.mHead.store(mHeader->mTail.load(std::memory_order_acquire), std::memory_order_seq_cst);
+                cursor.mPid.store(static_cast<int32_t>(getpid()), std::memory_order_seq_cst);
+                // the publisher may have moved on before it saw the cursor.
+                cursor.mHead.store(mHeader->mTail.load(std::memory_order_seq_cst), std::memory_order_release);
+                mCursor = &cursor;
+                return;
+            }
+        }
+    }
+
+    /** The mapped header of the ring. */
+    ShmRingHeader* mHeader;
+    /** The mapped slots of the ring. */
+    const T* mSlots;
+    /** The read position of this receiver. */
+    ShmRingHeader::Cursor* mCursor;
+    /** The size of the mapping. */
+    size_t mSize;
+};
@@ -0,0 +1,200 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <sched.h>
+#include <type_traits>
+#include <utility>
+#include "ring_utils.h"
+
+
+/**
+ * Defines what happens when an element is pushed to a full queue.
+ */
+enum class OverflowPolicy
+{
+    /** The producer waits until the consumer frees a slot. */
+    BLOCK,
+    /** The new element is discarded. */
+    DROP_NEWEST,
+    /** The oldest element that was not yet consumed is discarded to make space for the new one. */
+    DROP_OLDEST
+};
+
+/**
+ * Bounded lock-free single-producer/single-consumer ring buffer. Each slot carries a sequence
+ * number telling the producer whether the slot is free for its current lap, so the consumer
+ * can hand a slot back only after it has moved the element out. The read index is claimed
+ * with a CAS, which lets the producer discard the oldest element without the consumer ever
+ * reading a slot that is being overwritten.
+ */
+template<typename T>
+class SpscQueue
+{
+    static_assert(std::is_default_constructible<T>::value, "SpscQueue requires default constructible elements, as all slots are preallocated");
+
+public:
+    /**
+     * Basic constructor that preallocates all slots.
+     *  @param capacity the minimum number of elements the queue can hold, rounded up to a power of two
+     *         and to at least 2, as a single slot could not tell a full queue from an empty one.
+     *  @param policy the behaviour of push when the queue is full.
+     */
+    explicit SpscQueue(const size_t capacity, const OverflowPolicy policy = OverflowPolicy::BLOCK)
+    : mCapacity(roundUpToPowerOfTwo(capacity < 2 ? 2 : capacity)), mMask(mCapacity - 1), mPolicy(policy), mSlots(new Slot[mCapacity]), mHead(0), mTail(0), mDropped(0)
+    {
+        for (size_t i = 0; i < mCapacity; ++i)
+        {
+            mSlots[i].mSequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * Pushes a new element to the queue. Must be called from a single producer thread at a time.
+     *  @param value the element to push.
+     *  @return false if @p value was dropped because the queue was full.
+     */
+    template<typename U>
+    bool push(U&& value)
+    {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        Slot& slot = mSlots[tail & mMask];
+
+        if (slot.mSequence.load(std::memory_order_acquire) != tail)
+        {
+            if (OverflowPolicy::DROP_NEWEST == mPolicy)
+            {
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            size_t oldest = tail - mCapacity;
+            if (OverflowPolicy::DROP_OLDEST == mPolicy
+                && mHead.compare_exchange_strong(oldest, oldest + 1, std::memory_order_acq_rel))
+            {
+                // the slot now belongs to the producer and will be overwritten below.
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                // either blocking or the consumer has just claimed the oldest element.
+                while (slot.mSequence.load(std::memory_order_acquire) != tail)
+                {
+                    sched_yield();
+                }
+            }
+        }
+
+        slot.mValue = std::forward<U>(value);
+        slot.mSequence.store(tail + 1, std::memory_order_release);
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Pops the oldest element from the queue. Must be called from a single consumer thread at a time.
+     *  @param[out] value the popped element.
+     *  @return false if the queue was empty.
+     */
+    bool pop(T& value)
+    {
+        size_t head = mHead.load(std::memory_order_acquire);
+        do
+        {
+            if (head == mTail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+        }
+        while (!mHead.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel));
+
+        Slot& slot = mSlots[head & mMask];
+        value = std::move(slot.mValue);
+        slot.mSequence.store(head + mCapacity, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     *  @return true if there is no element to pop.
+     */
+    inline bool isEmpty() const
+    {
+        return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Tells if push would have to block or drop an element. Must be called from the producer thread.
+     *  @return true if the queue is full.
+     */
+    inline bool isFull() const
+    {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        return mSlots[tail & mMask].mSequence.load(std::memory_order_acquire) != tail;
+    }
+
+    /**
+     *  @return the number of elements the queue can hold.
+     */
+    inline size_t getCapacity() const
+    {
+        return mCapacity;
+    }
+
+    /**
+     *  @return the number of elements dropped due to overflow.
+     */
+    inline size_t getDropped() const
+    {
+        return mDropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    /** A single element of the ring buffer. */
+    struct Slot
+    {
+        /** Equal to the producer index when free, and to that index plus one when holding an element. */
+        std::atomic<size_t> mSequence;
+        /** Stored element. */
+        T mValue;
+    };
+
+    /** Number of slots. */
+    const size_t mCapacity;
+    /** Mask used to map an index to a slot. */
+    const size_t mMask;
+    /** The behaviour of push when the queue is full. */
+    const OverflowPolicy mPolicy;
+    /** Preallocated slots. */
+    std::unique_ptr<Slot[]> mSlots;
+    /** Index of the next element to consume, claimed by the consumer or by the producer dropping it. */
+    alignas(64) std::atomic<size_t> mHead;
+    /** Index of the next slot to fill, written only by the producer. */
+    alignas(64) std::atomic<size_t> mTail;
+    /** Number of elements dropped due to overflow. */
+    alignas(64) std::atomic<size_t> mDropped;
+};
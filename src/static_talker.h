@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <tuple>
+
+
+/**
+ * A talker whose listeners are fixed when it is constructed. The types of listeners are
+ * template parameters, so notifyListeners expands into one direct call of update per listener
+ * which the compiler can inline; there is no list to lock and no registration. Listeners do not
+ * have to derive from GenericListener, they only need an update method accepting the broadcast
+ * data. If update is virtual, declare it (or the listener class) final so that the call is
+ * devirtualised. Listeners must outlive the talker.
+ */
+template<typename... Listeners>
+class StaticTalker
+{
+public:
+    /**
+     * Basic constructor.
+     *  @param listeners the listeners to broadcast to, updated in the given order.
+     */
+    explicit StaticTalker(Listeners&... listeners) : mListeners(&listeners...), mTalk(true)
+    {
+    }
+
+    /**
+     * Pauses the talker from broadcasting updates.
+     */
+    inline void pause()
+    {
+        mTalk.store(false, std::memory_order_release);
+    }
+
+    /**
+     * Resumes the talker to broadcast updates.
+     */
+    inline void resume()
+    {
+        mTalk.store(true, std::memory_order_release);
+    }
+
+    /**
+     *  @return true if the talker is broadcasting updates.
+     */
+    inline bool isTalking() const
+    {
+        return mTalk.load(std::memory_order_acquire);
+    }
+
+protected:
+    /**
+     * Notifies all listeners with a new data.
+     *  @param data new data to broadcast to listeners.
+     */
+    template<typename... Args>
+    inline void notifyListeners(const Args&... data) const
+    {
+        if (isTalking())
+        {
+            std::apply([&data...](Listeners*... listeners) { (listeners->update(data...), ...); }, mListeners);
+        }
+    }
+
+private:
+    /** The listeners to broadcast to. */
+    const std::tuple<Listeners*...> mListeners;
+    /** Flag indicating if the talker should broadcast updates or not. */
+    std::atomic<bool> mTalk;
+};
@@ -0,0 +1,698 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+#include "generic_listener.h"
+#include "generic_talker.h"
+#include "generic_thread.h"
+#include "locks.h"
+#include "scoped_lock.h"
+
+
+/**
+ * Layout of a recording file. The file starts with RecordFileHeader, followed by records
+ * appended one after another, each one made of RecordHeader and its payload padded to
+ * ALIGNMENT. Every INDEX_INTERVAL records the timestamp and offset of a record are appended
+ * to the index file, "<path>.idx", which lets a replayer seek by time without reading the
+ * records before. Timestamps are CLOCK_MONOTONIC nanoseconds and never decrease within a file.
+ */
+struct RecordFileHeader
+{
+    /** Value of mMagic in a recording file. */
+    static constexpr uint64_t MAGIC = 0x3143455253544c55;
+    /** Alignment of records and payloads in the file. */
+    static constexpr size_t ALIGNMENT = 16;
+    /** The number of records between two index entries. */
+    static constexpr uint64_t INDEX_INTERVAL = 1024;
+
+    /** Identifies the file as a recording. */
+    uint64_t mMagic;
+    /** CLOCK_REALTIME in nanoseconds when the recording started, to map timestamps to wall time. */
+    int64_t mStartRealtime;
+    /** CLOCK_MONOTONIC in nanoseconds when the recording started. */
+    int64_t mStartMonotonic;
+    /** Offset of the end of the last record, 0 if the writer did not finish the file. */
+    uint64_t mEnd;
+    /** The number of records, 0 if the writer did not finish the file. */
+    uint64_t mCount;
+    uint64_t mReserved[3];
+};
+
+/**
+ * Header of a single record.
+ */
+struct RecordHeader
+{
+    /** CLOCK_MONOTONIC in nanoseconds when the record was appended. */
+    int64_t mTimestamp;
+    /** The stream the record belongs to. */
+    uint32_t mChannel;
+    /** The size of the payload in bytes. */
+    uint32_t mSize;
+
+    /**
+     *  @param size the size of a payload.
+     *  @return the distance between the beginnings of a record and the next one.
+     */
+    static inline size_t getLength(const size_t size)
+    {
+        return (sizeof(RecordHeader) + size + RecordFileHeader::ALIGNMENT - 1) & ~(RecordFileHeader::ALIGNMENT - 1);
+    }
+};
+
+/**
+ * Entry of the index file.
+ */
+struct RecordIndexEntry
+{
+    /** Timestamp of the indexed record. */
+    int64_t mTimestamp;
+    /** Offset of the indexed record in the recording file. */
+    uint64_t mOffset;
+};
+
+static_assert(sizeof(RecordFileHeader) % RecordFileHeader::ALIGNMENT == 0 && sizeof(RecordHeader) % RecordFileHeader::ALIGNMENT == 0,
+              "Records have to keep their payloads aligned");
+
+/**
+ * Appends records to a recording file through a shared memory mapping. The file grows by
+ * doubling its size and is truncated to the recorded data when the writer is destroyed. Records
+ * are written to the page cache by the kernel, so a recording survives a crash of the process;
+ * a file that was not finished is replayed up to its last complete record. A single writer can
+ * be shared by several StreamRecorder instances, one per channel, and appends are thread-safe.
+ */
+class RecordWriter
+{
+public:
+    /**
+     * Basic constructor that creates or truncates the recording and its index.
+     *  @param path the path of the recording file.
+     *  @param capacity the initial size of the file in bytes.
+     */
+    explicit RecordWriter(const std::string& path, const size_t capacity = 64 << 20)
+    : mFd(-1), mIndexFd(-1), mMemory(nullptr), mCapacity(0), mEnd(sizeof(RecordFileHeader)), mCount(0)
+    {
+        mFd = open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        mIndexFd = open((path + ".idx").c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_APPEND, 0644);
+        size_t size = capacity > sizeof(RecordFileHeader) ? capacity : sizeof(RecordFileHeader);
+        if (mFd >= 0 && mIndexFd >= 0 && 0 == ftruncate(mFd, static_cast<off_t>(size)))
+        {
+            void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+            if (MAP_FAILED != memory)
+            {
+                timespec realtime;
+                clock_gettime(CLOCK_REALTIME, &realtime);
+                mMemory = static_cast<char*>(memory);
+                mCapacity = size;
+                RecordFileHeader* header = getHeader();
+                header->mMagic = RecordFileHeader::MAGIC;
+                header->mStartRealtime = static_cast<int64_t>(realtime.tv_sec) * 1000000000 + realtime.tv_nsec;
+                header->mStartMonotonic = monotonicNow();
+            }
+        }
+    }
+
+    /**
+     * Class destructor that finishes the recording. Recorders using the writer must be destroyed first.
+     */
+    ~RecordWriter()
+    {
+        if (isOpen())
+        {
+            getHeader()->mEnd = mEnd;
+            getHeader()->mCount = mCount;
+            munmap(mMemory, mCapacity);
+            if (0 != ftruncate(mFd, static_cast<off_t>(mEnd)))
+            {
+                // the file keeps its zero-filled tail, which the replayer skips.
+            }
+        }
+        if (mFd >= 0)
+        {
+            close(mFd);
+        }
+        if (mIndexFd >= 0)
+        {
+            close(mIndexFd);
+        }
+    }
+
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    /**
+     *  @return true if the recording file was created and mapped.
+     */
+    inline bool isOpen() const
+    {
+        return nullptr != mMemory;
+    }
+
+    /**
+     * Appends a number of payloads of the same channel, each one as a separate record with the
+     * same timestamp.
+     *  @param channel the stream the payloads belong to.
+     *  @param data a contiguous array of payloads.
+     *  @param size the size of a single payload in bytes.
+     *  @param count the number of payloads.
+     *  @return false if the payloads are empty or the file could not grow, in which case nothing is appended.
+     */
+    bool append(const uint32_t channel, const void* data, const uint32_t size, const size_t count = 1)
+    {
+        const size_t length = RecordHeader::getLength(size);
+        ScopedLock lock(mLock);
+        if (0 == size || !reserve(mEnd + length * count))
+        {
+            return false;
+        }
+        // taking the timestamp under the lock keeps timestamps in the order of records.
+        int64_t timestamp = monotonicNow();
+        for (size_t i = 0; i < count; ++i)
+        {
+            RecordHeader* header = reinterpret_cast<RecordHeader*>(mMemory + mEnd);
+            header->mTimestamp = timestamp;
+            header->mChannel = channel;
+            memcpy(mMemory + mEnd + sizeof(RecordHeader), static_cast<const char*>(data) + i * size, size);
+            // the size is written last, so a reader of an unfinished file never sees a partial record.
+            std::atomic_thread_fence(std::memory_order_release);
+            header->mSize = size;
+            if (0 == mCount % RecordFileHeader::INDEX_INTERVAL)
+            {
+                RecordIndexEntry entry = {timestamp, mEnd};
+                if (sizeof(entry) != write(mIndexFd, &entry, sizeof(entry)))
+                {
+                    // the index is only an accelerator, seeking falls back to scanning records.
+                }
+            }
+            mEnd += length;
+            ++mCount;
+        }
+        return true;
+    }
+
+    /**
+     *  @return the number of records appended so far.
+     */
+    inline uint64_t getCount()
+    {
+        ScopedLock lock(mLock);
+        return mCount;
+    }
+
+private:
+    /**
+     *  @return the header of the file.
+     */
+    inline RecordFileHeader* getHeader()
+    {
+        return reinterpret_cast<RecordFileHeader*>(mMemory);
+    }
+
+    /**
+     * Grows the file and its mapping, if needed, to hold @p size bytes.
+     *  @param size the required size of the file.
+     *  @return false if the file could not grow.
+     */
+    bool reserve(const size_t size)
+    {
+        if (!isOpen())
+        {
+            return false;
+        }
+        if (size <= mCapacity)
+        {
+            return true;
+        }
+        size_t capacity = mCapacity;
+        while (capacity < size)
+        {
+            capacity *= 2;
+        }
+        if (0 != ftruncate(mFd, static_cast<off_t>(capacity)))
+        {
+            return false;
+        }
+        void* memory = mremap(mMemory, mCapacity, capacity, MREMAP_MAYMOVE);
+        if (MAP_FAILED == memory)
+        {
+            return false;
+        }
+        mMemory = static_cast<char*>(memory);
+        mCapacity = capacity;
+        return true;
+    }
+
+    /** The recording file. */
+    int mFd;
+    /** The index file. */
+    int mIndexFd;
+    /** Mapping of the whole recording file. */
+    char* mMemory;
+    /** The size of the file and its mapping. */
+    size_t mCapacity;
+    /** Offset of the end of the last record. */
+    size_t mEnd;
+    /** The number of records. */
+    uint64_t mCount;
+    /** Serialises appends. */
+    Mutex mLock;
+};
+
+/**
+ * A listener that records every update of the talkers it is registered to as one channel of
+ * a recording. Payloads have to be trivially copyable, so that they can be replayed from the
+ * file as they are.
+ * Lock has to match the lock of the recorded talkers.
+ */
+template<typename Lock, typename T>
+class BasicStreamRecorder : public BasicListener<Lock, T>
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Recorded payloads must be trivially copyable");
+    static_assert(alignof(T) <= RecordFileHeader::ALIGNMENT, "Recorded payloads must fit the alignment of records");
+
+public:
+    /**
+     * Basic constructor.
+     *  @param writer the recording to append to, it must outlive the recorder.
+     *  @param channel the channel of recorded payloads, used to route them when replaying.
+     */
+    BasicStreamRecorder(RecordWriter& writer, const uint32_t channel) : BasicListener<Lock, T>(), mWriter(writer), mChannel(channel)
+    {
+    }
+
+    /**
+     * Class destructor that unregisters the recorder from all talkers.
+     */
+    virtual ~BasicStreamRecorder()
+    {
+        this->unregisterAll();
+    }
+
+    /**
+     * Appends a payload to the recording.
+     *  @param data the payload.
+     */
+    void update(const T& data) override
+    {
+        if (!mWriter.append(mChannel, &data, sizeof(T)))
+        {
+            this->countDropped();
+        }
+    }
+
+    /**
+     * Appends a batch of payloads to the recording under a single lock.
+     *  @param samples the payloads, oldest first.
+     *  @param count the number of payloads.
+     */
+    void updateBatch(const T* samples, const size_t count) override
+    {
+        if (!mWriter.append(mChannel, samples, sizeof(T), count))
+        {
+            this->countDropped(count);
+        }
+    }
+
+private:
+    /** The recording to append to. */
+    RecordWriter& mWriter;
+    /** The channel of recorded payloads. */
+    const uint32_t mChannel;
+};
+
+/**
+ * Stream recorder with the lock selected by LockPolicy.
+ */
+template<typename T>
+using StreamRecorder = BasicStreamRecorder<typename LockPolicy<T>::Type, T>;
+
+/**
+ * A destination of replayed records of one channel.
+ */
+class ReplayChannel
+{
+public:
+    virtual ~ReplayChannel() = default;
+
+    /**
+     * Broadcasts a replayed payload.
+     *  @param payload the payload, pointing into the mapping of the recording.
+     *  @param size the size of the payload in bytes.
+     *  @return false if the payload does not match the channel.
+     */
+    virtual bool replay(const void* payload, const uint32_t size) = 0;
+};
+
+/**
+ * A talker that broadcasts payloads of one channel of a recording. Listeners receive
+ * references into the mapped file, so payloads are not copied.
+ */
+template<typename T>
+class ReplayTalker : public GenericTalker<T>, public ReplayChannel
+{
+public:
+    /**
+     * Broadcasts a replayed payload.
+     *  @param payload the payload, pointing into the mapping of the recording.
+     *  @param size the size of the payload in bytes.
+     *  @return false if the size of the payload differs from the size of T.
+     */
+    bool replay(const void* payload, const uint32_t size) override
+    {
+        if (sizeof(T) != size)
+        {
+            return false;
+        }
+        this->notifyListeners(*static_cast<const T*>(payload));
+        return true;
+    }
+};
+
+/**
+ * Replays a recording on its own thread, routing each record to the ReplayTalker of its
+ * channel. The file is mapped read-only and read sequentially, and pages already replayed are
+ * released, so recordings much larger than the memory can be replayed. Records are replayed
+ * at a chosen speed relative to the recording, against absolute deadlines, so the pace does
+ * not drift; speed 0 replays as fast as possible.
+ */
+class StreamReplayer : public GenericThread<StreamReplayer>
+{
+public:
+    /**
+     * Basic constructor that maps the recording and its index, if present.
+     *  @param path the path of the recording file.
+     */
+    explicit StreamReplayer(const std::string& path)
+    : GenericThread<StreamReplayer>(), mMemory(nullptr), mSize(0), mIndex(nullptr), mIndexSize(0), mEnd(0), mPosition(0),
+      mReleased(0), mSpeed(1.0), mReplayed(0), mSkipped(0), mFinished(false)
+    {
+        // sleeping until the next record is scheduled would only burn the CPU.
+        mEvent.setSpins(0);
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && 0 == fstat(fd, &st) && static_cast<size_t>(st.st_size) >= sizeof(RecordFileHeader))
+        {
+            void* memory = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (MAP_FAILED != memory)
+            {
+                const RecordFileHeader* header = static_cast<const RecordFileHeader*>(memory);
+                if (RecordFileHeader::MAGIC == header->mMagic)
+                {
+                    mMemory = static_cast<const char*>(memory);
+                    mSize = static_cast<size_t>(st.st_size);
+                    mEnd = (header->mEnd > 0 && header->mEnd <= mSize) ? header->mEnd : mSize;
+                    mPosition = sizeof(RecordFileHeader);
+                    madvise(memory, mSize, MADV_SEQUENTIAL);
+                }
+                else
+                {
+                    munmap(memory, static_cast<size_t>(st.st_size));
+                }
+            }
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        mapIndex(path + ".idx");
+    }
+
+    /**
+     * Class destructor that stops replaying and unmaps the recording.
+     */
+    virtual ~StreamReplayer()
+    {
+        stopThread();
+        if (nullptr != mMemory)
+        {
+            munmap(const_cast<char*>(mMemory), mSize);
+        }
+        if (nullptr != mIndex)
+        {
+            munmap(const_cast<RecordIndexEntry*>(mIndex), mIndexSize * sizeof(RecordIndexEntry));
+        }
+    }
+
+    /**
+     *  @return true if the recording was mapped.
+     */
+    inline bool isOpen() const
+    {
+        return nullptr != mMemory;
+    }
+
+    /**
+     * Routes records of a channel to a talker. Records of channels without a talker are skipped.
+     * Must not be called while replaying.
+     *  @param channel the channel of records.
+     *  @param talker the talker to broadcast them, it must outlive the replayer.
+     */
+    void addChannel(const uint32_t channel, ReplayChannel* talker)
+    {
+        mChannels[channel] = talker;
+    }
+
+    /**
+     * Sets the speed of the replay. Must not be called while replaying.
+     *  @param speed the speed relative to the recording, e.g. 1 for real time, 0 for as fast as possible.
+     */
+    inline void setSpeed(const double speed)
+    {
+        mSpeed = speed > 0.0 ? speed : 0.0;
+    }
+
+    /**
+     * Moves the replay to the first record with a timestamp not earlier than @p timestamp.
+     * Must not be called while replaying.
+     *  @param timestamp the monotonic timestamp of the recording in nanoseconds.
+     *  @return false if no such record exists, in which case the replay is at the end.
+     */
+    bool seek(const int64_t timestamp)
+    {
+        size_t position = sizeof(RecordFileHeader);
+        // the last indexed record before the timestamp is found by binary search.
+        size_t low = 0;
+        size_t high = mIndexSize;
+        while (low < high)
+        {
+            size_t middle = low + (high - low) / 2;
+            if (mIndex[middle].mTimestamp < timestamp)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        if (low > 0 && mIndex[low - 1].mOffset < mEnd)
+        {
+            position = mIndex[low - 1].mOffset;
+        }
+
+        const RecordHeader* record = nullptr;
+        while (nullptr != (record = getRecord(position)) && record->mTimestamp < timestamp)
+        {
+            position += RecordHeader::getLength(record->mSize);
+        }
+        mPosition = position;
+        mFinished.store(nullptr == record, std::memory_order_release);
+        return nullptr != record;
+    }
+
+    /**
+     *  @return the timestamp of the next record to replay, or -1 at the end of the recording.
+     */
+    int64_t getNextTimestamp() const
+    {
+        const RecordHeader* record = getRecord(mPosition);
+        return nullptr == record ? -1 : record->mTimestamp;
+    }
+
+    /**
+     *  @return the header of the recording. Valid only if isOpen().
+     */
+    inline const RecordFileHeader& getFileHeader() const
+    {
+        return *reinterpret_cast<const RecordFileHeader*>(mMemory);
+    }
+
+    /**
+     *  @return the number of records replayed so far.
+     */
+    inline uint64_t getReplayed() const
+    {
+        return mReplayed.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return the number of records skipped because no talker matched their channel and size.
+     */
+    inline uint64_t getSkipped() const
+    {
+        return mSkipped.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @return true once the whole recording was replayed.
+     */
+    inline bool isFinished() const
+    {
+        return mFinished.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Replays records from the current position until the end of the recording or until the
+     * thread is stopped.
+     */
+    void* threadBody()
+    {
+        const RecordHeader* record = getRecord(mPosition);
+        const int64_t recordStart = nullptr == record ? 0 : record->mTimestamp;
+        const int64_t start = monotonicNow();
+        while (isRunning() && nullptr != record)
+        {
+            if (mSpeed > 0.0)
+            {
+                int64_t deadline = start + static_cast<int64_t>(static_cast<double>(record->mTimestamp - recordStart) / mSpeed);
+                // the event is raised by stopThread, so stopping does not wait for the next record.
+                while (isRunning() && mEvent.waitUntil(deadline))
+                {
+                }
+                if (!isRunning())
+                {
+                    break;
+                }
+            }
+
+            std::unordered_map<uint32_t, ReplayChannel*>::const_iterator channel = mChannels.find(record->mChannel);
+            if (mChannels.end() != channel && channel->second->replay(record + 1, record->mSize))
+            {
+                mReplayed.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                mSkipped.fetch_add(1, std::memory_order_relaxed);
+            }
+            mPosition += RecordHeader::getLength(record->mSize);
+            releaseReplayed();
+            record = getRecord(mPosition);
+        }
+        mFinished.store(nullptr == record, std::memory_order_release);
+        return nullptr;
+    }
+
+private:
+    /** The amount of replayed data after which its pages are released. */
+    static constexpr size_t RELEASE_STEP = 16 << 20;
+
+    /**
+     *  @param position offset of a record in the file.
+     *  @return the record at @p position, or nullptr if there is no complete record.
+     */
+    const RecordHeader* getRecord(const size_t position) const
+    {
+        if (nullptr == mMemory || position + sizeof(RecordHeader) > mEnd)
+        {
+            return nullptr;
+        }
+        const RecordHeader* record = reinterpret_cast<const RecordHeader*>(mMemory + position);
+        // an unfinished file ends with zeros, which is a record of no size.
+        return (0 == record->mSize || position + RecordHeader::getLength(record->mSize) > mEnd) ? nullptr : record;
+    }
+
+    /**
+     * Releases pages that were replayed, so that the resident memory does not grow with the
+     * size of the recording. The data stays in the file and the page cache.
+     */
+    void releaseReplayed()
+    {
+        size_t position = mPosition & ~(static_cast<size_t>(sysconf(_SC_PAGESIZE)) - 1);
+        if (position >= mReleased + RELEASE_STEP)
+        {
+            madvise(const_cast<char*>(mMemory) + mReleased, position - mReleased, MADV_DONTNEED);
+            mReleased = position;
+        }
+    }
+
+    /**
+     * Maps the index of the recording, if it exists.
+     *  @param path the path of the index file.
+     */
+    void mapIndex(const std::string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && 0 == fstat(fd, &st) && static_cast<size_t>(st.st_size) >= sizeof(RecordIndexEntry))
+        {
+            void* memory = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (MAP_FAILED != memory)
+            {
+                mIndex = static_cast<const RecordIndexEntry*>(memory);
+                mIndexSize = static_cast<size_t>(st.st_size) / sizeof(RecordIndexEntry);
+            }
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    /** Mapping of the whole recording file. */
+    const char* mMemory;
+    /** The size of the file and its mapping. */
+    size_t mSize;
+    /** Mapping of the index file, nullptr if there is no index. */
+    const RecordIndexEntry* mIndex;
+    /** The number of index entries. */
+    size_t mIndexSize;
+    /** Offset of the end of the last record. */
+    size_t mEnd;
+    /** Offset of the next record to replay. */
+    size_t mPosition;
+    /** Offset up to which pages were released. */
+    size_t mReleased;
+    /** The speed of the replay relative to the recording, 0 for as fast as possible. */
+    double mSpeed;
+    /** The number of replayed records. */
+    std::atomic<uint64_t> mReplayed;
+    /** The number of skipped records. */
+    std::atomic<uint64_t> mSkipped;
+    /** Raised once the whole recording was replayed. */
+    std::atomic<bool> mFinished;
+    /** Talkers of channels. */
+    std::unordered_map<uint32_t, ReplayChannel*> mChannels;
+};
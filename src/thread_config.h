@@ -0,0 +1,167 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <alloca.h>
+#include <cerrno>
+#include <cstddef>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+/**
+ * Settings applied to a thread started with GenericThread::startThread(const ThreadConfig&).
+ * Default values leave the corresponding setting untouched.
+ */
+struct ThreadConfig
+{
+    ThreadConfig() : mPolicy(-1), mPriority(0), mStackSize(0), mPrefaultSize(0)
+    {
+        CPU_ZERO(&mAffinity);
+    }
+
+    /**
+     * Allows the thread to run on a given CPU. The thread is pinned as soon as any CPU is added.
+     *  @param cpu the index of a CPU.
+     *  @return reference to this configuration.
+     */
+    ThreadConfig& addCpu(const int cpu)
+    {
+        CPU_SET(cpu, &mAffinity);
+        return *this;
+    }
+
+    /** CPUs the thread may run on, empty to inherit the affinity of the creating thread. */
+    cpu_set_t mAffinity;
+    /** Scheduling policy such as SCHED_FIFO, SCHED_RR or SCHED_OTHER, -1 to inherit it. */
+    int mPolicy;
+    /** Scheduling priority used together with mPolicy. */
+    int mPriority;
+    /** Size of the thread stack in bytes, 0 for the default size. */
+    size_t mStackSize;
+    /** Number of bytes of the stack to touch before threadBody runs, so it does not page fault later.
+     *  It is limited to the part of the stack still free, less a safety margin. */
+    size_t mPrefaultSize;
+    /** Name of the thread visible in tools like top, up to 15 characters. Empty to keep the default. */
+    std::string mName;
+};
+
+/**
+ * Result of applying a ThreadConfig. Each field holds the error number returned when applying
+ * the corresponding setting, or 0 if the setting was applied or not requested.
+ */
+struct ThreadConfigStatus
+{
+    ThreadConfigStatus() : mStackSize(0), mScheduling(0), mAffinity(0), mName(0), mPrefaultSize(0)
+    {
+    }
+
+    /**
+     *  @return true if all requested settings were applied.
+     */
+    inline bool isApplied() const
+    {
+        return 0 == mStackSize && 0 == mScheduling && 0 == mAffinity && 0 == mName && 0 == mPrefaultSize;
+    }
+
+    /** Error setting the stack size, e.g. EINVAL if it is lower than PTHREAD_STACK_MIN. */
+    int mStackSize;
+    /** Error setting the scheduling policy and priority, e.g. EPERM without CAP_SYS_NICE. */
+    int mScheduling;
+    /** Error setting the CPU affinity, e.g. EINVAL if none of the CPUs is available. */
+    int mAffinity;
+    /** Error setting the name, e.g. ERANGE if it is longer than 15 characters. */
+    int mName;
+    /** ERANGE if the prefault size exceeds the free part of the stack, which is then prefaulted
+     *  as a whole, or the error of reading the stack bounds, in which case nothing is prefaulted. */
+    int mPrefaultSize;
+};
+
+/**
+ * Applies the part of @p config that a thread has to apply to itself.
+ *  @param config the settings to apply.
+ *  @param[out] status errors of settings that could not be applied.
+ */
+__attribute__((noinline)) inline void applyThreadConfig(const ThreadConfig& config, ThreadConfigStatus& status)
+{
+    pthread_t self = pthread_self();
+    if (config.mPolicy >= 0)
+    {
+        sched_param param = {};
+        param.sched_priority = config.mPriority;
+        status.mScheduling = pthread_setschedparam(self, config.mPolicy, &param);
+    }
+    if (CPU_COUNT(&config.mAffinity) > 0)
+    {
+        status.mAffinity = pthread_setaffinity_np(self, sizeof(config.mAffinity), &config.mAffinity);
+    }
+    if (!config.mName.empty())
+    {
+        status.mName = pthread_setname_np(self, config.mName.c_str());
+    }
+    if (config.mPrefaultSize > 0)
+    {
+        // the stack grows down, so the free part lies between its lowest address and the current frame.
+        pthread_attr_t attr;
+        void* lowest = nullptr;
+        size_t stackSize = 0;
+        status.mPrefaultSize = pthread_getattr_np(self, &attr);
+        if (0 == status.mPrefaultSize)
+        {
+            status.mPrefaultSize = pthread_attr_getstack(&attr, &lowest, &stackSize);
+            pthread_attr_destroy(&attr);
+        }
+        if (0 == status.mPrefaultSize)
+        {
+            // the margin covers the frames of this function and the guard against running into the end of the stack.
+            const size_t margin = 16 * 1024;
+            const size_t available = static_cast<size_t>(reinterpret_cast<char*>(&attr) - static_cast<char*>(lowest));
+            size_t size = config.mPrefaultSize;
+            if (size + margin > available)
+            {
+                size = available > margin ? available - margin : 0;
+                status.mPrefaultSize = ERANGE;
+            }
+            // the memory allocated on the stack is released when this function returns, but its pages stay mapped.
+            volatile unsigned char* stack = static_cast<unsigned char*>(alloca(size > 0 ? size : 1));
+            const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            for (size_t i = 0; i < size; i += page)
+            {
+                stack[i] = 0;
+            }
+        }
+    }
+}
+
+/**
+ * Locks all current and future pages of the process in memory, so that no thread is delayed by
+ * page faults. Should be called once, early in the process, typically together with stack prefaulting.
+ *  @return 0 on success, or the error number (e.g. EPERM or ENOMEM when the memlock limit is too low).
+ */
+inline int lockProcessMemory()
+{
+    return 0 == mlockall(MCL_CURRENT | MCL_FUTURE) ? 0 : errno;
+}
@@ -0,0 +1,262 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "generic_thread.h"
+#include "scoped_lock.h"
+
+
+/**
+ * A pool of worker threads with a deque per worker. A worker takes its own tasks from the back
+ * of its deque, which keeps recently submitted work hot in its cache, and when it runs out of
+ * work it steals the oldest task from the front of another worker's deque. Tasks are plain
+ * function pointers with a context, so submitting does not allocate a closure.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * A unit of work: calls mFunction(mContext, mIndex).
+     */
+    struct Task
+    {
+        void (*mFunction)(void* context, size_t index);
+        void* mContext;
+        size_t mIndex;
+    };
+
+    /**
+     * Basic constructor that starts all workers.
+     *  @param workers the number of worker threads, at least one is started.
+     */
+    explicit ThreadPool(const size_t workers) : mNext(0)
+    {
+        for (size_t i = 0; i < (workers > 0 ? workers : 1); ++i)
+        {
+            mWorkers.emplace_back(new Worker(*this, i));
+        }
+        for (std::unique_ptr<Worker>& worker : mWorkers)
+        {
+            worker->startThread();
+        }
+    }
+
+    /**
+     * Class destructor that runs all remaining tasks and stops the workers.
+     */
+    ~ThreadPool()
+    {
+        // workers are stopped one by one and each runs pending tasks before it exits,
+        // so the last one drains all deques.
+        for (std::unique_ptr<Worker>& worker : mWorkers)
+        {
+            worker->stopThread();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Submits a task. A worker submits to its own deque, any other thread spreads tasks across
+     * workers in a round-robin fashion. Then the first idle worker, starting from the one after
+     * the submitting worker or from the one that got the task, is woken up to run or steal it.
+     * If no worker is idle, none is woken up: busy workers look for tasks before going idle.
+     *  @param task the task to run.
+     */
+    void submit(const Task& task)
+    {
+        Worker* worker = Worker::sCurrent;
+        size_t start;
+        if (nullptr != worker && &worker->mPool == this)
+        {
+            worker->push(task);
+            start = worker->mIndex + 1;
+        }
+        else
+        {
+            start = mNext.fetch_add(1, std::memory_order_relaxed);
+            mWorkers[start % mWorkers.size()]->push(task);
+        }
+        // pairs with the fence in Worker::threadBody: either a worker going idle sees the task, or it is seen idle here.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (size_t i = 0; i < mWorkers.size(); ++i)
+        {
+            worker = mWorkers[(start + i) % mWorkers.size()].get();
+            if (worker->mIdle.load(std::memory_order_relaxed) && worker->mIdle.exchange(false, std::memory_order_acq_rel))
+            {
+                worker->wake();
+                break;
+            }
+        }
+    }
+
+    /**
+     * Runs a single pending task on the calling thread. Useful to help the pool while waiting
+     * for submitted tasks to finish.
+     *  @return false if there was no task to run.
+     */
+    bool runPending()
+    {
+        Task task;
+        Worker* worker = Worker::sCurrent;
+        size_t start = (nullptr != worker && &worker->mPool == this) ? worker->mIndex : 0;
+        if (take(start, task))
+        {
+            task.mFunction(task.mContext, task.mIndex);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     *  @return the number of worker threads.
+     */
+    inline size_t getWorkerCount() const
+    {
+        return mWorkers.size();
+    }
+
+private:
+    /**
+     * A worker thread with its own deque of tasks.
+     */
+    class Worker : public GenericThread<Worker>
+    {
+    public:
+        Worker(ThreadPool& pool, const size_t index) : GenericThread<Worker>(), mPool(pool), mIndex(index), mIdle(false)
+        {
+        }
+
+        void* threadBody()
+        {
+            sCurrent = this;
+            while (true)
+            {
+                if (mPool.runPending())
+                {
+                    continue;
+                }
+                if (!this->isRunning())
+                {
+                    break;
+                }
+                // looks for tasks once more after going idle, so a task submitted in between is not missed.
+                mIdle.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (mPool.runPending())
+                {
+                    mIdle.store(false, std::memory_order_relaxed);
+                    continue;
+                }
+                this->mEvent.wait();
+                mIdle.store(false, std::memory_order_relaxed);
+            }
+            return nullptr;
+        }
+
+        void wake()
+        {
+            this->mEvent.notify();
+        }
+
+        void push(const Task& task)
+        {
+            ScopedLock lock(this->mMutex);
+            mTasks.push_back(task);
+        }
+
+        /**
+         * Takes the newest task, used by the owner.
+         */
+        bool popBack(Task& task)
+        {
+            ScopedLock lock(this->mMutex);
+            if (mTasks.empty())
+            {
+                return false;
+            }
+            task = mTasks.back();
+            mTasks.pop_back();
+            return true;
+        }
+
+        /**
+         * Takes the oldest task, used by thieves.
+         */
+        bool popFront(Task& task)
+        {
+            ScopedLock lock(this->mMutex);
+            if (mTasks.empty())
+            {
+                return false;
+            }
+            task = mTasks.front();
+            mTasks.pop_front();
+            return true;
+        }
+
+        /** The pool this worker belongs to. */
+        ThreadPool& mPool;
+        /** Position of this worker in the pool. */
+        const size_t mIndex;
+        /** Tasks queued for this worker. */
+        std::deque<Task> mTasks;
+        /** Flag indicating that the worker found no task and waits to be woken up. */
+        std::atomic<bool> mIdle;
+        /** The worker running on the calling thread, if any. */
+        inline static thread_local Worker* sCurrent = nullptr;
+    };
+
+    /**
+     * Takes a task from the deque at @p start, stealing from the other deques if it is empty.
+     */
+    bool take(const size_t start, Task& task)
+    {
+        if (mWorkers.empty())
+        {
+            return false;
+        }
+        if (mWorkers[start]->popBack(task))
+        {
+            return true;
+        }
+        for (size_t i = 1; i < mWorkers.size(); ++i)
+        {
+            if (mWorkers[(start + i) % mWorkers.size()]->popFront(task))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Worker threads. */
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    /** Round-robin counter for tasks submitted from outside the pool. */
+    std::atomic<size_t> mNext;
+};
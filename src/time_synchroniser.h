@@ -0,0 +1,320 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "generic_listener.h"
+#include "generic_talker.h"
+#include "ring_utils.h"
+
+
+/**
+ * Matches samples of several talkers by their timestamps and publishes matched sets as a
+ * GenericTalker<Inputs...>. Each input is a listener, obtained with getInput<I>() and registered
+ * to the talker of that input. Samples wait in a bounded single-producer/single-consumer ring per
+ * input, so publishers of different inputs never block each other; a sample arriving at a full
+ * ring is dropped. Matching runs on the publishing thread that delivered the last sample, and
+ * only one thread matches at a time, so matched sets are published one by one and in order.
+ *
+ * The latest of the oldest waiting samples is the pivot. Every other input contributes the
+ * sample closest to the pivot, which may require waiting for its next sample, and the set is
+ * published if all its timestamps lie within the window. Samples that can no longer be matched
+ * are discarded. A window of 0 matches only identical timestamps. Timestamps of each input
+ * must not decrease.
+ *
+ * The synchroniser and its inputs use the locks selected by LockPolicy. Each input has the lock
+ * of its own type, so they are changed by specialising LockPolicy rather than by a parameter.
+ */
+template<typename... Inputs>
+class TimeSynchroniser : public GenericTalker<Inputs...>
+{
+    static_assert((std::is_default_constructible<Inputs>::value && ...), "TimeSynchroniser requires default constructible inputs");
+
+public:
+    /** The result of moving an input towards the pivot. */
+    enum class Approach
+    {
+        READY,
+        MOVED,
+        WAIT
+    };
+
+    /** Returns the timestamp of a sample in nanoseconds. */
+    template<typename T>
+    using Timestamp = int64_t (*)(const T&);
+
+    /**
+     * A listener that buffers samples of one input.
+     */
+    template<typename T>
+    class Input : public GenericListener<T>
+    {
+    public:
+        /**
+         * Basic constructor.
+         *  @param owner the synchroniser the input belongs to.
+         *  @param capacity the number of samples the input buffers, rounded up to a power of two.
+         *  @param timestamp returns the timestamp of a sample.
+         */
+        Input(TimeSynchroniser& owner, const size_t capacity, const Timestamp<T> timestamp)
+        : GenericListener<T>(), mOwner(owner), mCapacity(roundUpToPowerOfTwo(capacity)), mSlots(new T[mCapacity]),
+          mStamps(new int64_t[mCapacity]), mTimestamp(timestamp), mHead(0), mTail(0), mDropped(0)
+        {
+        }
+
+        /**
+         * Class destructor that unregisters from all talkers.
+         */
+        virtual ~Input()
+        {
+            this->unregisterAll();
+        }
+
+        /**
+         * Buffers a sample and matches samples of all inputs. Must be called from a single
+         * publishing thread at a time.
+         *  @param sample a new sample.
+         */
+        void update(const T& sample) override
+        {
+            size_t tail = mTail.load(std::memory_order_relaxed);
+            if (tail - mHead.load(std::memory_order_acquire) == mCapacity)
+            {
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+                this->countDropped();
+                return;
+            }
+            mSlots[tail & (mCapacity - 1)] = sample;
+            mStamps[tail & (mCapacity - 1)] = mTimestamp(sample);
+            mTail.store(tail + 1, std::memory_order_release);
+            mOwner.match();
+        }
+
+        /**
+         *  @return the number of samples dropped because the ring was full.
+         */
+        inline uint64_t getDropped() const
+        {
+            return mDropped.load(std::memory_order_relaxed);
+        }
+
+    private:
+        friend class TimeSynchroniser;
+
+        /**
+         *  @return the number of buffered samples.
+         */
+        inline size_t size() const
+        {
+            return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_relaxed);
+        }
+
+        /**
+         *  @param index the index of a buffered sample, 0 for the oldest.
+         *  @return the timestamp of the sample.
+         */
+        inline int64_t stamp(const size_t index) const
+        {
+            return mStamps[(mHead.load(std::memory_order_relaxed) + index) & (mCapacity - 1)];
+        }
+
+        /**
+         *  @return the oldest buffered sample.
+         */
+        inline const T& front() const
+        {
+            return mSlots[mHead.load(std::memory_order_relaxed) & (mCapacity - 1)];
+        }
+
+        /**
+         * Discards the oldest buffered sample.
+         */
+        inline void pop()
+        {
+            mHead.store(mHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * Moves to the buffered sample closest to the pivot.
+         *  @param pivot the timestamp to match.
+         *  @param window the maximum difference of matched timestamps.
+         *  @return MOVED if the oldest sample changed, WAIT if the next sample may be closer
+         *          but has not arrived yet, READY otherwise.
+         */
+        Approach approach(const int64_t pivot, const int64_t window)
+        {
+            bool moved = false;
+            while (size() > 1 && stamp(1) <= pivot)
+            {
+                pop();
+                moved = true;
+            }
+            if (stamp(0) >= pivot)
+            {
+                return moved ? Approach::MOVED : Approach::READY;
+            }
+            if (size() < 2)
+            {
+                // a sample out of the window is discarded anyway, so there is nothing to wait for.
+                return pivot - stamp(0) > window ? Approach::READY : Approach::WAIT;
+            }
+            if (stamp(1) - pivot < pivot - stamp(0))
+            {
+                pop();
+                return Approach::MOVED;
+            }
+            return moved ? Approach::MOVED : Approach::READY;
+        }
+
+        /** The synchroniser the input belongs to. */
+        TimeSynchroniser& mOwner;
+        /** The number of slots. */
+        const size_t mCapacity;
+        /** Buffered samples. */
+        std::unique_ptr<T[]> mSlots;
+        /** Timestamps of buffered samples. */
+        std::unique_ptr<int64_t[]> mStamps;
+        /** Returns the timestamp of a sample. */
+        const Timestamp<T> mTimestamp;
+        /** Index of the oldest buffered sample, written only by the matching thread. */
+        alignas(64) std::atomic<size_t> mHead;
+        /** Index of the next slot to fill, written only by the publisher. */
+        alignas(64) std::atomic<size_t> mTail;
+        /** The number of dropped samples. */
+        std::atomic<uint64_t> mDropped;
+    };
+
+    /**
+     * Basic constructor.
+     *  @param window the maximum difference of timestamps of matched samples in nanoseconds.
+     *  @param capacity the number of samples buffered per input.
+     *  @param timestamps functions returning timestamps of samples of each input.
+     */
+    TimeSynchroniser(const int64_t window, const size_t capacity, const Timestamp<Inputs>... timestamps)
+    : GenericTalker<Inputs...>(), mInputs(std::make_unique<Input<Inputs>>(*this, capacity, timestamps)...), mWindow(window), mRequests(0), mMatched(0)
+    {
+    }
+
+    /**
+     * Class destructor that unregisters all inputs from their talkers.
+     */
+    virtual ~TimeSynchroniser()
+    {
+        std::apply([](std::unique_ptr<Input<Inputs>>&... inputs) { (inputs->unregisterAll(), ...); }, mInputs);
+    }
+
+    /**
+     *  @return the listener of the input @p I, to be registered to the talker of that input.
+     */
+    template<size_t I>
+    inline auto& getInput()
+    {
+        return *std::get<I>(mInputs);
+    }
+
+    /**
+     *  @return the number of published matched sets.
+     */
+    inline uint64_t getMatched() const
+    {
+        return mMatched.load(std::memory_order_relaxed);
+    }
+
+private:
+    /**
+     * Matches buffered samples. A thread that finds another one matching leaves its request to
+     * that thread, which keeps matching until there are no new requests.
+     */
+    void match()
+    {
+        if (0 != mRequests.fetch_add(1, std::memory_order_acq_rel))
+        {
+            return;
+        }
+        uint64_t requests = 1;
+        do
+        {
+            requests = mRequests.load(std::memory_order_acquire);
+            matchBuffered(std::index_sequence_for<Inputs...>());
+        }
+        while (requests != mRequests.fetch_sub(requests, std::memory_order_acq_rel));
+    }
+
+    /**
+     * Publishes matched sets of buffered samples until an input has to wait for more samples.
+     */
+    template<size_t... Is>
+    void matchBuffered(std::index_sequence<Is...>)
+    {
+        while (((0 != std::get<Is>(mInputs)->size()) && ...))
+        {
+            const int64_t pivot = std::max({std::get<Is>(mInputs)->stamp(0)...});
+            Approach approaches[] = {std::get<Is>(mInputs)->approach(pivot, mWindow)...};
+            bool moved = false;
+            bool wait = false;
+            for (Approach approach : approaches)
+            {
+                moved = moved || Approach::MOVED == approach;
+                wait = wait || Approach::WAIT == approach;
+            }
+            if (moved)
+            {
+                continue;
+            }
+            if (wait)
+            {
+                return;
+            }
+
+            const int64_t oldest = std::min({std::get<Is>(mInputs)->stamp(0)...});
+            if (pivot - oldest <= mWindow)
+            {
+                this->notifyListeners(std::get<Is>(mInputs)->front()...);
+                (std::get<Is>(mInputs)->pop(), ...);
+                mMatched.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                // the oldest sample is too far from the pivot, and later samples of other inputs are even further.
+                ((oldest == std::get<Is>(mInputs)->stamp(0) && (std::get<Is>(mInputs)->pop(), true)) || ...);
+            }
+        }
+    }
+
+    /** The inputs. */
+    std::tuple<std::unique_ptr<Input<Inputs>>...> mInputs;
+    /** The maximum difference of timestamps of matched samples. */
+    const int64_t mWindow;
+    /** The number of match requests not yet served, non-zero while a thread is matching. */
+    std::atomic<uint64_t> mRequests;
+    /** The number of published matched sets. */
+    std::atomic<uint64_t> mMatched;
+};
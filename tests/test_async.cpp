@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <async_listener.h>
+#include <generic_talker.h>
+
+
+class SlowListener : public GenericListener<int, std::string>
+{
+public:
+    SlowListener() : mCounter(0), mLast(-1) {}
+
+    void update(const int& value, const std::string&) override
+    {
+        usleep(1000);
+        ++mCounter;
+        mLast = value;
+    }
+
+    int mCounter;
+    int mLast;
+};
+
+class MyTalker : public GenericTalker<int, std::string>
+{
+public:
+    void publish(const int value)
+    {
+        notifyListeners(value, std::to_string(value));
+    }
+};
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+static bool runTest(const char* name, const OverflowPolicy policy)
+{
+    SlowListener slow;
+    MyTalker talker;
+    size_t dropped;
+    double elapsed;
+    {
+        AsyncListener<int, std::string> async(&slow, 8, policy);
+        talker.registerTo(&async);
+        double start = now();
+        for (int i = 0; i < 100; ++i)
+        {
+            talker.publish(i);
+        }
+        elapsed = now() - start;
+        dropped = async.getDropped();
+    }
+    printf("%s: publishing took %f s, delivered %d, dropped %zu, last %d \n", name, elapsed, slow.mCounter, dropped, slow.mLast);
+    return (100 == slow.mCounter + static_cast<int>(dropped)) && (OverflowPolicy::DROP_NEWEST == policy || 99 == slow.mLast);
+}
+
+int main()
+{
+    bool ok = runTest("Block", OverflowPolicy::BLOCK);
+    ok &= runTest("Drop newest", OverflowPolicy::DROP_NEWEST);
+    ok &= runTest("Drop oldest", OverflowPolicy::DROP_OLDEST);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <tuple>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <latest_value_listener.h>
+
+
+/**
+ * Processes batches in a single loop.
+ */
+class SummingListener : public GenericListener<int>
+{
+public:
+    SummingListener() : mSum(0), mUpdates(0), mBatches(0) {}
+
+    void update(const int& value) override
+    {
+        mSum += value;
+        ++mUpdates;
+    }
+
+    void updateBatch(const int* values, const size_t count) override
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            mSum += values[i];
+        }
+        ++mBatches;
+    }
+
+    long mSum;
+    int mUpdates;
+    int mBatches;
+};
+
+/**
+ * Does not override updateBatch, so it receives every sample through update.
+ */
+class OrderListener : public GenericListener<int>
+{
+public:
+    OrderListener() : mNext(0), mErrors(0) {}
+
+    void update(const int& value) override
+    {
+        mErrors += (value != mNext) ? 1 : 0;
+        mNext = value + 1;
+    }
+
+    int mNext;
+    int mErrors;
+};
+
+class PairListener : public GenericListener<int, double>
+{
+public:
+    PairListener() : mCounter(0), mSum(0.0) {}
+
+    void update(const int& index, const double& value) override
+    {
+        mCounter += index >= 0 ? 1 : 0;
+        mSum += value;
+    }
+
+    int mCounter;
+    double mSum;
+};
+
+class MyTalker : public GenericTalker<int>
+{
+public:
+    void publish(const int* values, const size_t count)
+    {
+        notifyListenersBatch(values, count);
+    }
+};
+
+class PairTalker : public GenericTalker<int, double>
+{
+public:
+    void publish(const std::tuple<int, double>* values, const size_t count)
+    {
+        notifyListenersBatch(values, count);
+    }
+};
+
+int main()
+{
+    int values[100];
+    for (int i = 0; i < 100; ++i)
+    {
+        values[i] = i;
+    }
+    MyTalker talker;
+    SummingListener summing;
+    OrderListener order;
+    LatestValueListener<int> latest;
+    talker.registerTo(&summing);
+    talker.registerTo(&order);
+    talker.registerTo(&latest);
+    talker.publish(values, 60);
+    talker.publish(values + 60, 40);
+
+    int last = -1;
+    latest.latest(last);
+    printf("Summing: sum %ld, updates %d, batches %d \n", summing.mSum, summing.mUpdates, summing.mBatches);
+    printf("Order: next %d, errors %d \n", order.mNext, order.mErrors);
+    printf("Latest: value %d, version %lu \n", last, latest.getVersion());
+    bool ok = 4950 == summing.mSum && 0 == summing.mUpdates && 2 == summing.mBatches;
+    ok = ok && 100 == order.mNext && 0 == order.mErrors && 99 == last && 100 == latest.getVersion();
+
+    std::tuple<int, double> pairs[3] = {{0, 0.5}, {1, 1.5}, {2, 2.0}};
+    PairTalker pairTalker;
+    PairListener pair;
+    pairTalker.registerTo(&pair);
+    pairTalker.publish(pairs, 3);
+    pairTalker.pause();
+    pairTalker.publish(pairs, 3);
+    printf("Pairs: counter %d, sum %f \n", pair.mCounter, pair.mSum);
+    ok = ok && 3 == pair.mCounter && 4.0 == pair.mSum;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <generic_thread.h>
+
+
+static const int PUBLISHERS = 4;
+static const int MESSAGES = 20000;
+
+/**
+ * A listener that is not thread safe. It detects overlapping updates and checks that updates
+ * of each publisher arrive in order.
+ */
+class OrderListener : public GenericListener<int, int>
+{
+public:
+    OrderListener() : mBusy(false), mOverlaps(0), mErrors(0), mReceived(0)
+    {
+        for (int& last : mLast)
+        {
+            last = -1;
+        }
+    }
+
+    void update(const int& publisher, const int& sequence) override
+    {
+        if (mBusy.exchange(true, std::memory_order_acquire))
+        {
+            ++mOverlaps;
+        }
+        mErrors += (sequence != mLast[publisher] + 1) ? 1 : 0;
+        mLast[publisher] = sequence;
+        ++mReceived;
+        mBusy.store(false, std::memory_order_release);
+    }
+
+    std::atomic<bool> mBusy;
+    int mOverlaps;
+    int mErrors;
+    int mReceived;
+    int mLast[PUBLISHERS];
+};
+
+class MyTalker : public GenericTalker<int, int>
+{
+public:
+    using GenericTalker<int, int>::GenericTalker;
+
+    void publish(const int publisher, const int sequence) const
+    {
+        notifyListeners(publisher, sequence);
+    }
+};
+
+class Publisher : public GenericThread<Publisher>
+{
+public:
+    Publisher(const MyTalker& talker, const int index) : mTalker(talker), mIndex(index) {}
+
+    void* threadBody()
+    {
+        for (int i = 0; i < MESSAGES; ++i)
+        {
+            mTalker.publish(mIndex, i);
+        }
+        return nullptr;
+    }
+
+private:
+    const MyTalker& mTalker;
+    const int mIndex;
+};
+
+int main()
+{
+    MyTalker talker(BroadcastMode::CONCURRENT);
+    std::vector<OrderListener> listeners(3);
+    for (OrderListener& listener : listeners)
+    {
+        talker.registerTo(&listener);
+    }
+    std::vector<std::unique_ptr<Publisher>> publishers;
+    for (int i = 0; i < PUBLISHERS; ++i)
+    {
+        publishers.emplace_back(new Publisher(talker, i));
+        publishers.back()->startThread();
+    }
+    // registration is still allowed while publishers broadcast.
+    OrderListener late;
+    talker.registerTo(&late);
+    talker.unregisterFrom(&late);
+    for (std::unique_ptr<Publisher>& publisher : publishers)
+    {
+        publisher->stopThread();
+    }
+
+    bool ok = true;
+    for (OrderListener& listener : listeners)
+    {
+        printf("Received %d, overlaps %d, order errors %d \n", listener.mReceived, listener.mOverlaps, listener.mErrors);
+        ok = ok && PUBLISHERS * MESSAGES == listener.mReceived && 0 == listener.mOverlaps && 0 == listener.mErrors;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <unistd.h>
+#include <vector>
+#include <coroutine_listener.h>
+#include <generic_talker.h>
+
+
+static const int CONSUMERS = 200;
+static const int EXECUTORS = 2;
+static const int SAMPLES = 2000;
+
+class OdometryTalker : public GenericTalker<int, double>
+{
+public:
+    void publish(const int sequence)
+    {
+        notifyListeners(sequence, 0.25 * sequence);
+    }
+};
+
+/**
+ * Statistics collected by one consumer.
+ */
+struct Consumed
+{
+    long mReceived = 0;
+    long mErrors = 0;
+    bool mFinished = false;
+};
+
+/**
+ * A stateful consumer written as a loop: it checks that samples come in order and intact.
+ */
+static CoroutineTask consume(CoroutineListener<int, double>& listener, Consumed& consumed)
+{
+    int last = -1;
+    while (std::optional<std::tuple<int, double>> sample = co_await listener.next())
+    {
+        auto [sequence, distance] = *sample;
+        if (sequence <= last || distance != 0.25 * sequence)
+        {
+            ++consumed.mErrors;
+        }
+        last = sequence;
+        ++consumed.mReceived;
+    }
+    consumed.mFinished = true;
+}
+
+int main()
+{
+    std::vector<std::unique_ptr<CoroutineExecutor>> executors;
+    for (int i = 0; i < EXECUTORS; ++i)
+    {
+        executors.push_back(std::make_unique<CoroutineExecutor>());
+    }
+
+    OdometryTalker talker;
+    std::vector<std::unique_ptr<CoroutineListener<int, double>>> listeners;
+    std::vector<Consumed> consumed(CONSUMERS);
+    for (int i = 0; i < CONSUMERS; ++i)
+    {
+        CoroutineExecutor& executor = *executors[i % EXECUTORS];
+        listeners.push_back(std::make_unique<CoroutineListener<int, double>>(executor, 64));
+        talker.registerTo(listeners.back().get());
+        executor.spawn(consume(*listeners.back(), consumed[i]));
+    }
+
+    for (int i = 0; i < SAMPLES; ++i)
+    {
+        talker.publish(i);
+        if (0 == i % 32)
+        {
+            // give executors a chance to drain the rings, as they may be dropped otherwise.
+            usleep(100);
+        }
+    }
+    for (std::unique_ptr<CoroutineListener<int, double>>& listener : listeners)
+    {
+        listener->close();
+    }
+    for (int i = 0; i < 5000 && (0 != executors[0]->getActive() || 0 != executors[1]->getActive()); ++i)
+    {
+        usleep(1000);
+    }
+
+    long received = 0;
+    long dropped = 0;
+    long errors = 0;
+    int finished = 0;
+    for (int i = 0; i < CONSUMERS; ++i)
+    {
+        received += consumed[i].mReceived;
+        dropped += static_cast<long>(listeners[i]->getDropped());
+        errors += consumed[i].mErrors + (consumed[i].mReceived + static_cast<long>(listeners[i]->getDropped()) != SAMPLES ? 1 : 0);
+        finished += consumed[i].mFinished ? 1 : 0;
+    }
+    printf("%d coroutines on %d executors finished %d, received %ld, dropped %ld, errors %ld \n",
+           CONSUMERS, EXECUTORS, finished, received, dropped, errors);
+    return (CONSUMERS == finished && 0 == errors && received > 0) ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <vector>
+#include <unistd.h>
+#include <event.h>
+#include <generic_thread.h>
+
+
+/**
+ * Answers every ping with a pong.
+ */
+class PingPong : public GenericThread<PingPong>
+{
+public:
+    void* threadBody()
+    {
+        while (this->isRunning())
+        {
+            mEvent.wait();
+            if (this->isRunning())
+            {
+                mPong.notify();
+            }
+        }
+        return nullptr;
+    }
+
+    void ping()
+    {
+        mEvent.notify();
+    }
+
+    Event mPong;
+};
+
+/**
+ * Waits without a timeout until it is stopped.
+ */
+class Sleeper : public GenericThread<Sleeper>
+{
+public:
+    void* threadBody()
+    {
+        while (this->isRunning())
+        {
+            mEvent.wait();
+        }
+        return nullptr;
+    }
+};
+
+int main()
+{
+    bool ok = true;
+
+    // notifications coalesce into one and are not lost if sent before waiting.
+    Event event;
+    event.notify();
+    event.notify();
+    event.notify();
+    ok = ok && event.waitFor(0) && !event.tryWait();
+
+    int64_t start = monotonicNow();
+    bool raised = event.waitFor(2000000);
+    int64_t elapsed = monotonicNow() - start;
+    printf("Timed wait: raised %d after %ld ns \n", raised, elapsed);
+    ok = ok && !raised && elapsed >= 2000000;
+
+    PingPong thread;
+    thread.startThread();
+    std::vector<int64_t> latencies;
+    for (int i = 0; i < 10000; ++i)
+    {
+        start = monotonicNow();
+        thread.ping();
+        thread.mPong.wait();
+        latencies.push_back(monotonicNow() - start);
+    }
+    thread.stopThread();
+    std::sort(latencies.begin(), latencies.end());
+    printf("Round trip: p50 %ld ns, p99 %ld ns \n", latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100]);
+
+    Sleeper sleeper;
+    sleeper.startThread();
+    usleep(10000);
+    start = monotonicNow();
+    sleeper.stopThread();
+    elapsed = monotonicNow() - start;
+    printf("Stopping a sleeping thread took %ld ns \n", elapsed);
+    ok = ok && elapsed < 100000000;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <generic_talker.h>
+#include <history_listener.h>
+
+
+static const int64_t MILLISECOND = 1000000;
+
+struct Pose
+{
+    int64_t mStamp;
+    double mX;
+    double mHeading;
+};
+
+class PoseTalker : public GenericTalker<Pose>
+{
+public:
+    void publish(const Pose& pose)
+    {
+        notifyListeners(pose);
+    }
+};
+
+class CounterTalker : public GenericTalker<int, double>
+{
+public:
+    void publish(const int value)
+    {
+        notifyListeners(value, 0.5 * value);
+    }
+};
+
+static int64_t poseStamp(const Pose& pose)
+{
+    return pose.mStamp;
+}
+
+/**
+ * Looks up values and neighbours of a 10 ms pose history after it wrapped around.
+ */
+static bool testLookup()
+{
+    PoseTalker talker;
+    HistoryListener<Pose> history(100, poseStamp);
+    talker.registerTo(&history);
+    for (int i = 0; i < 1000; ++i)
+    {
+        talker.publish({i * 10 * MILLISECOND, 0.1 * i, 0.0});
+    }
+
+    // 128 slots hold poses 872 to 999.
+    int errors = 0;
+    HistoryListener<Pose>::Record before;
+    HistoryListener<Pose>::Record after;
+    if (!history.latest(before) || 999 * 10 * MILLISECOND != before.mTimestamp)
+    {
+        ++errors;
+    }
+    if (!history.find(900 * 10 * MILLISECOND + 3 * MILLISECOND, before) || 900 * 10 * MILLISECOND != before.mSample.mStamp)
+    {
+        ++errors;
+    }
+    if (!history.findAround(950 * 10 * MILLISECOND + 4 * MILLISECOND, before, after)
+        || 950 * 10 * MILLISECOND != before.mTimestamp || 951 * 10 * MILLISECOND != after.mTimestamp)
+    {
+        ++errors;
+    }
+    if (!history.findAround(960 * 10 * MILLISECOND, before, after) || before.mTimestamp != after.mTimestamp
+        || 960 * 10 * MILLISECOND != after.mTimestamp)
+    {
+        ++errors;
+    }
+    if (history.find(871 * 10 * MILLISECOND, before) || !history.find(872 * 10 * MILLISECOND, before))
+    {
+        ++errors;
+    }
+    if (history.findAround(999 * 10 * MILLISECOND + 1, before, after))
+    {
+        ++errors;
+    }
+    printf("Lookup: %lu samples, capacity %lu, %d errors \n", static_cast<unsigned long>(history.getCount()),
+           static_cast<unsigned long>(history.getCapacity()), errors);
+    return 0 == errors;
+}
+
+/**
+ * Queries the history of a talker with several arguments and arrival timestamps while it is written.
+ */
+static bool testConcurrentReaders()
+{
+    CounterTalker talker;
+    HistoryListener<int, double> history(64);
+    talker.registerTo(&history);
+    std::atomic<bool> running(true);
+    std::atomic<long> errors(0);
+    std::atomic<long> queries(0);
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r)
+    {
+        readers.emplace_back([&]()
+        {
+            HistoryListener<int, double>::Record before;
+            HistoryListener<int, double>::Record after;
+            while (running.load(std::memory_order_relaxed))
+            {
+                if (!history.latest(before))
+                {
+                    continue;
+                }
+                int64_t time = before.mTimestamp - 1000;
+                if (history.findAround(time, before, after))
+                {
+                    // both samples must be intact and adjacent.
+                    if (std::get<1>(before.mSample) != 0.5 * std::get<0>(before.mSample)
+                        || std::get<1>(after.mSample) != 0.5 * std::get<0>(after.mSample)
+                        || before.mTimestamp > time || after.mTimestamp < time
+                        || (before.mTimestamp != after.mTimestamp && std::get<0>(after.mSample) != std::get<0>(before.mSample) + 1))
+                    {
+                        errors.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                queries.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    for (int i = 0; i < 2000000; ++i)
+    {
+        talker.publish(i);
+    }
+    running.store(false, std::memory_order_relaxed);
+    for (std::thread& reader : readers)
+    {
+        reader.join();
+    }
+    printf("Concurrent readers: %ld queries with %ld errors \n", queries.load(), errors.load());
+    return 0 == errors.load();
+}
+
+int main()
+{
+    bool passed = testLookup();
+    passed = testConcurrentReaders() && passed;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <generic_talker.h>
+#include <generic_thread.h>
+#include <latest_value_listener.h>
+
+
+struct Pose
+{
+    long mStamp;
+    double mX;
+    double mY;
+};
+
+class PoseTalker : public GenericTalker<Pose, int>, public GenericThread<PoseTalker>
+{
+public:
+    explicit PoseTalker(const long samples) : mSamples(samples) {}
+
+    void* threadBody()
+    {
+        for (long i = 1; i <= mSamples; ++i)
+        {
+            Pose pose = {i, static_cast<double>(i), -static_cast<double>(i)};
+            notifyListeners(pose, static_cast<int>(i % 1000));
+        }
+        return nullptr;
+    }
+
+private:
+    long mSamples;
+};
+
+class ControlLoop : public GenericThread<ControlLoop>
+{
+public:
+    explicit ControlLoop(const LatestValueListener<Pose, int>& pose) : mPose(pose), mReads(0), mErrors(0), mLast(0) {}
+
+    void* threadBody()
+    {
+        Pose pose;
+        int remainder;
+        while (isRunning())
+        {
+            if (mPose.latest(pose, remainder))
+            {
+                ++mReads;
+                // torn reads would break the relation between fields, and values must never go back.
+                if (pose.mX != -pose.mY || pose.mStamp % 1000 != remainder || pose.mStamp < mLast)
+                {
+                    ++mErrors;
+                }
+                mLast = pose.mStamp;
+            }
+        }
+        return nullptr;
+    }
+
+    const LatestValueListener<Pose, int>& mPose;
+    long mReads;
+    long mErrors;
+    long mLast;
+};
+
+int main()
+{
+    PoseTalker talker(2000000);
+    LatestValueListener<Pose, int> latest;
+    ControlLoop first(latest);
+    ControlLoop second(latest);
+    Pose pose;
+    int remainder;
+
+    bool ok = !latest.latest(pose, remainder);
+    talker.registerTo(&latest);
+    first.startThread();
+    second.startThread();
+    talker.startThread();
+    talker.stopThread();
+    first.stopThread();
+    second.stopThread();
+
+    ok &= latest.latest(pose, remainder) && 2000000 == pose.mStamp && 2000000 == latest.getVersion();
+    printf("Latest stamp: %ld, readers: %ld reads with %ld errors, %ld reads with %ld errors \n",
+           pose.mStamp, first.mReads, first.mErrors, second.mReads, second.mErrors);
+    ok &= (0 == first.mErrors) && (0 == second.mErrors);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <generic_thread.h>
+#include <latest_value_listener.h>
+#include <locks.h>
+#include <scoped_lock.h>
+
+
+struct Sample
+{
+    int mValue;
+};
+
+struct SingleThreadSample
+{
+    int mValue;
+};
+
+// the trait only selects the default lock, talkers of the same signature can still choose another one.
+template<> struct LockPolicy<SingleThreadSample> { using Type = NullLock; };
+
+/**
+ * Increments a shared counter under a lock.
+ */
+template<typename Lock>
+class Incrementer : public GenericThread<Incrementer<Lock>>
+{
+public:
+    Incrementer(Lock& lock, long& counter) : mLock(lock), mCounter(counter) {}
+
+    void* threadBody()
+    {
+        for (int i = 0; i < 100000; ++i)
+        {
+            ScopedLock lock(mLock);
+            ++mCounter;
+        }
+        return nullptr;
+    }
+
+private:
+    Lock& mLock;
+    long& mCounter;
+};
+
+template<typename Lock>
+bool testLock(const char* name)
+{
+    Lock lock;
+    long counter = 0;
+    std::vector<std::unique_ptr<Incrementer<Lock>>> threads;
+    for (int i = 0; i < 4; ++i)
+    {
+        threads.emplace_back(new Incrementer<Lock>(lock, counter));
+        threads.back()->startThread();
+    }
+    for (std::unique_ptr<Incrementer<Lock>>& thread : threads)
+    {
+        thread->stopThread();
+    }
+    bool free = lock.tryLock();
+    lock.unlock();
+    printf("%s: counter %ld \n", name, counter);
+    return 400000 == counter && free;
+}
+
+template<typename Lock, typename Sample>
+class Listener : public BasicListener<Lock, Sample>
+{
+public:
+    Listener() : mSum(0) {}
+
+    void update(const Sample& sample) override
+    {
+        mSum += sample.mValue;
+    }
+
+    int mSum;
+};
+
+template<typename Lock, typename Sample>
+class Talker : public BasicTalker<Lock, Sample>
+{
+public:
+    void publish(const int value)
+    {
+        this->notifyListeners(Sample{value});
+    }
+};
+
+/**
+ * Registration works both ways with non-recursive locks, as no lock is taken twice.
+ */
+template<typename Lock, typename Sample>
+bool testTalker(const char* name)
+{
+    Listener<Lock, Sample> first;
+    Listener<Lock, Sample> second;
+    bool ok;
+    {
+        Talker<Lock, Sample> talker;
+        talker.registerTo(&first);
+        second.registerTo(&talker);
+        talker.publish(2);
+        first.unregisterFrom(&talker);
+        talker.publish(3);
+        ok = 2 == first.mSum && 5 == second.mSum;
+    }
+    // the talker unregistered itself when it was destroyed.
+    Talker<Lock, Sample> other;
+    second.registerTo(&other);
+    other.publish(1);
+    ok = ok && 6 == second.mSum;
+    printf("%s talker: %s \n", name, ok ? "passed" : "failed");
+    return ok;
+}
+
+int main()
+{
+    bool ok = testLock<SpinLock>("SpinLock");
+    ok = testLock<TicketLock>("TicketLock") && ok;
+    ok = testLock<Mutex>("Mutex") && ok;
+    ok = testLock<RecursiveMutex>("RecursiveMutex") && ok;
+
+    RecursiveMutex recursive;
+    recursive.lock();
+    ok = recursive.tryLock() && ok;
+    recursive.unlock();
+    recursive.unlock();
+
+    ok = testTalker<SpinLock, Sample>("SpinLock") && ok;
+    ok = testTalker<Mutex, Sample>("Mutex") && ok;
+    ok = testTalker<LockPolicy<SingleThreadSample>::Type, SingleThreadSample>("NullLock") && ok;
+    ok = testTalker<RecursiveMutex, SingleThreadSample>("RecursiveMutex") && ok;
+    static_assert(std::is_same_v<BasicTalker<NullLock, SingleThreadSample>, GenericTalker<SingleThreadSample>>, "the trait selects the default lock");
+
+    // listeners of the library take the lock of their talkers as well.
+    Talker<SpinLock, Sample> spinTalker;
+    BasicLatestValueListener<SpinLock, Sample> latest;
+    spinTalker.registerTo(&latest);
+    spinTalker.publish(7);
+    Sample value{0};
+    ok = latest.latest(value) && 7 == value.mValue && ok;
+    return ok ? 0 : 1;
+}
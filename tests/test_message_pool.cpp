@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <message_pool.h>
+
+
+struct Frame
+{
+    Frame() : mId(0), mPixels(1920 * 1080 * 3) {}
+
+    int mId;
+    std::vector<uint8_t> mPixels;
+};
+
+class CameraTalker : public GenericTalker<MessageHandle<Frame>>
+{
+public:
+    CameraTalker() : GenericTalker<MessageHandle<Frame>>(), mPool(4), mId(0) {}
+
+    bool capture()
+    {
+        MessageHandle<Frame> frame = mPool.acquire();
+        if (!frame)
+        {
+            puts("Pool exhausted, frame skipped");
+            return false;
+        }
+        frame->mId = ++mId;
+        frame->mPixels[0] = static_cast<uint8_t>(mId);
+        notifyListeners(frame);
+        return true;
+    }
+
+    MessagePool<Frame> mPool;
+
+private:
+    int mId;
+};
+
+/**
+ * Keeps the last few frames without copying them.
+ */
+class RecordingListener : public GenericListener<MessageHandle<Frame>>
+{
+public:
+    void update(const MessageHandle<Frame>& frame) override
+    {
+        printf("Received frame %d at %p, references: %u \n", frame->mId, static_cast<void*>(frame.get()), frame.getReferenceCount());
+        mFrames.push_back(frame);
+    }
+
+    std::vector<MessageHandle<Frame>> mFrames;
+};
+
+int main()
+{
+    CameraTalker camera;
+    RecordingListener recorder;
+    camera.registerTo(&recorder);
+    recorder.mFrames.reserve(8);
+
+    bool ok = true;
+    for (int i = 0; i < 4; ++i)
+    {
+        ok &= camera.capture();
+    }
+    // all slots are now held by the recorder.
+    ok &= !camera.capture();
+    printf("Available after capturing: %u \n", camera.mPool.getAvailable());
+    ok &= (0 == camera.mPool.getAvailable());
+
+    recorder.mFrames.erase(recorder.mFrames.begin());
+    printf("Available after releasing one frame: %u \n", camera.mPool.getAvailable());
+    ok &= (1 == camera.mPool.getAvailable()) && camera.capture();
+
+    recorder.mFrames.clear();
+    printf("Available after releasing all frames: %u \n", camera.mPool.getAvailable());
+    ok &= (4 == camera.mPool.getAvailable());
+
+    return ok ? 0 : 1;
+}
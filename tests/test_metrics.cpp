@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <unistd.h>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <metrics.h>
+
+
+class SleepyListener : public GenericListener<int>
+{
+public:
+    explicit SleepyListener(const useconds_t sleep) : mSleep(sleep) {}
+
+    void update(const int&) override
+    {
+        usleep(mSleep);
+    }
+
+private:
+    useconds_t mSleep;
+};
+
+class MyTalker : public GenericTalker<int>
+{
+public:
+    void publish(const int value)
+    {
+        notifyListeners(value);
+    }
+};
+
+static const MetricsRecord* find(const MetricsSnapshot& snapshot, const char* label)
+{
+    for (const MetricsRecord& record : snapshot)
+    {
+        if (record.mLabel == label)
+        {
+            return &record;
+        }
+    }
+    return nullptr;
+}
+
+int main()
+{
+    MyTalker talker;
+    SleepyListener fast(0);
+    SleepyListener slow(2000);
+    talker.setMetricsLabel("talker");
+    fast.setMetricsLabel("fast");
+    slow.setMetricsLabel("slow");
+
+    talker.publish(0);
+    talker.registerTo(&fast);
+    talker.registerTo(&slow);
+    for (int i = 0; i < 20; ++i)
+    {
+        talker.publish(i);
+    }
+    talker.pause();
+    talker.publish(0);
+    talker.publish(0);
+    talker.resume();
+
+    MetricsSnapshot snapshot = takeMetricsSnapshot();
+    for (const MetricsRecord& record : snapshot)
+    {
+        printf("%s %s: published %lu, paused %lu, dropped %lu, update p50 %lu ns max %lu ns, lock waits %lu max %lu ns \n",
+               MetricsKind::TALKER == record.mKind ? "talker" : "listener", record.mLabel.c_str(), record.mPublished,
+               record.mPaused, record.mDropped, record.mUpdateTime.getPercentile(0.5), record.mUpdateTime.getMax(),
+               record.mLockWait.getCount(), record.mLockWait.getMax());
+    }
+
+    const MetricsRecord* talkerRecord = find(snapshot, "talker");
+    const MetricsRecord* fastRecord = find(snapshot, "fast");
+    const MetricsRecord* slowRecord = find(snapshot, "slow");
+    bool ok = 3 == snapshot.size() && nullptr != talkerRecord && nullptr != fastRecord && nullptr != slowRecord;
+    // the first publish had no listener, so it counts as dropped.
+    ok = ok && MetricsKind::TALKER == talkerRecord->mKind && 21 == talkerRecord->mPublished
+         && 2 == talkerRecord->mPaused && 1 == talkerRecord->mDropped && talkerRecord->mLockWait.getCount() > 0;
+    ok = ok && MetricsKind::LISTENER == slowRecord->mKind && 20 == slowRecord->mUpdateTime.getCount()
+         && 20 == fastRecord->mUpdateTime.getCount()
+         && slowRecord->mUpdateTime.getPercentile(0.5) > fastRecord->mUpdateTime.getPercentile(0.5);
+
+    {
+        SleepyListener temporary(0);
+        ok = ok && 4 == takeMetricsSnapshot().size();
+    }
+    ok = ok && 3 == takeMetricsSnapshot().size();
+    return ok ? 0 : 1;
+}
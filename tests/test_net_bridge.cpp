@@ -0,0 +1,228 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <net_bridge.h>
+
+
+static const long SAMPLES = 200000;
+
+struct Telemetry
+{
+    long mSequence;
+    double mSpeed;
+    double mSteering;
+};
+
+class TelemetryTalker : public GenericTalker<Telemetry>
+{
+public:
+    void publish(const Telemetry& telemetry)
+    {
+        notifyListeners(telemetry);
+    }
+};
+
+class CheckingListener : public GenericListener<Telemetry>
+{
+public:
+    CheckingListener() : mReceived(0), mErrors(0), mLast(-1) {}
+
+    void update(const Telemetry& telemetry) override
+    {
+        if (telemetry.mSequence <= mLast || telemetry.mSpeed != 0.5 * static_cast<double>(telemetry.mSequence))
+        {
+            ++mErrors;
+        }
+        mLast = telemetry.mSequence;
+        ++mReceived;
+    }
+
+    long mReceived;
+    long mErrors;
+    long mLast;
+};
+
+static double seconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) + 1e-9 * static_cast<double>(ts.tv_nsec);
+}
+
+/**
+ * Sends samples through a talker over loopback, retrying those dropped because the ring was full.
+ *  @return the number of samples received within a few seconds.
+ */
+static long transfer(const NetProtocol protocol, CheckingListener& listener, uint64_t& lost)
+{
+    NetReceiver<Telemetry> receiver(protocol, 0, "127.0.0.1", 4 << 20);
+    receiver.registerTo(&listener);
+    NetPublisher<Telemetry> publisher(protocol, "127.0.0.1", receiver.getPort(), 4096);
+    TelemetryTalker talker;
+    talker.registerTo(&publisher);
+    if (!receiver.isOpen() || !publisher.isOpen())
+    {
+        puts("Could not open sockets");
+        return 0;
+    }
+
+    double start = seconds();
+    for (long i = 0; i < SAMPLES; ++i)
+    {
+        Telemetry telemetry = {i, 0.5 * static_cast<double>(i), 0.0};
+        if (i % 4096 == 4095 && NetProtocol::UDP == protocol)
+        {
+            // let the receiver keep up, as a datagram that does not fit into its buffer is lost.
+            sched_yield();
+        }
+        while (!publisher.publish(telemetry))
+        {
+            sched_yield();
+        }
+    }
+    talker.publish({SAMPLES, 0.5 * static_cast<double>(SAMPLES), 0.0});
+    for (int i = 0; i < 5000 && receiver.getReceived() + receiver.getLost() < static_cast<uint64_t>(SAMPLES) + 1; ++i)
+    {
+        usleep(1000);
+    }
+    double elapsed = seconds() - start;
+    lost = receiver.getLost();
+    printf("%s: received %lu, lost %lu, invalid %lu, sent %lu in %.3f s (%.0f messages/s) \n",
+           NetProtocol::UDP == protocol ? "UDP" : "TCP", static_cast<unsigned long>(receiver.getReceived()),
+           static_cast<unsigned long>(lost), static_cast<unsigned long>(receiver.getInvalid()),
+           static_cast<unsigned long>(publisher.getSent()), elapsed, static_cast<double>(receiver.getReceived()) / elapsed);
+    return static_cast<long>(receiver.getReceived());
+}
+
+/**
+ * Fills the connection to a receiver that never reads and checks that the publisher can still be
+ * destroyed, giving up the frames the receiver did not take.
+ *  @return true if the destructor returned within the drain timeout and a margin.
+ */
+static bool stall()
+{
+    int server = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address = {};
+    socklen_t length = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    // the connection is completed by the kernel, but it is never accepted, so nothing is read.
+    int size = 4096;
+    if (server < 0 || 0 != setsockopt(server, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size))
+        || 0 != bind(server, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) || 0 != listen(server, 1)
+        || 0 != getsockname(server, reinterpret_cast<sockaddr*>(&address), &length))
+    {
+        puts("Could not open the stalled receiver");
+        return false;
+    }
+    NetPublisher<Telemetry>* publisher = new NetPublisher<Telemetry>(NetProtocol::TCP, "127.0.0.1", ntohs(address.sin_port), 4096);
+    bool ok = publisher->isOpen();
+    // publishes until the ring stays full, i.e. the socket buffers are full and the sender thread waits.
+    int full = 0;
+    for (long i = 0; ok && full < 200 && i < 10 * SAMPLES; ++i)
+    {
+        Telemetry telemetry = {i, 0.5 * static_cast<double>(i), 0.0};
+        if (publisher->publish(telemetry))
+        {
+            full = 0;
+        }
+        else
+        {
+            ++full;
+            usleep(1000);
+        }
+    }
+    double start = seconds();
+    delete publisher;
+    double elapsed = seconds() - start;
+    close(server);
+    printf("Stalled TCP receiver: destroyed in %.3f s \n", elapsed);
+    return ok && full >= 200 && elapsed < NetPublisher<Telemetry>::DRAIN_TIMEOUT * 1e-3 + 2.0;
+}
+
+/**
+ * Sends a frame whose payload leaves padding at the end of the frame and reads it with a raw socket.
+ *  @return true if the padding arrived zeroed.
+ */
+static bool padding()
+{
+    using Frame = NetFrame<uint32_t>;
+    static const size_t CAPACITY = 64;
+    int server = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address = {};
+    socklen_t length = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (server < 0 || 0 != bind(server, reinterpret_cast<const sockaddr*>(&address), sizeof(address))
+        || 0 != getsockname(server, reinterpret_cast<sockaddr*>(&address), &length))
+    {
+        puts("Could not open the raw receiver");
+        return false;
+    }
+    {
+        // leaves freed memory full of ones, which the ring of the publisher is likely to reuse.
+        std::unique_ptr<char[]> garbage(new char[CAPACITY * sizeof(Frame)]);
+        memset(garbage.get(), 0xff, CAPACITY * sizeof(Frame));
+    }
+    NetPublisher<uint32_t> publisher(NetProtocol::UDP, "127.0.0.1", ntohs(address.sin_port), CAPACITY);
+    bool ok = publisher.isOpen() && publisher.publish(7);
+    unsigned char bytes[sizeof(Frame)];
+    pollfd fds = {server, POLLIN, 0};
+    ok = ok && 1 == poll(&fds, 1, 2000) && static_cast<ssize_t>(sizeof(Frame)) == recv(server, bytes, sizeof(bytes), 0);
+    close(server);
+    const size_t end = offsetof(Frame, mPayload) + sizeof(uint32_t);
+    for (size_t i = end; ok && i < sizeof(Frame); ++i)
+    {
+        ok = 0 == bytes[i];
+    }
+    printf("Frame padding: %s \n", ok ? "zeroed" : "not zeroed");
+    return ok;
+}
+
+int main()
+{
+    bool passed = true;
+    CheckingListener tcp;
+    uint64_t lost = 0;
+    // the stream is reliable, so every sample must arrive in order.
+    passed = (SAMPLES + 1 == transfer(NetProtocol::TCP, tcp, lost) && 0 == lost && 0 == tcp.mErrors) && passed;
+
+    // datagrams may be lost over loopback too, but those received must be intact and in order.
+    CheckingListener udp;
+    long received = transfer(NetProtocol::UDP, udp, lost);
+    passed = (received > 0 && received + static_cast<long>(lost) <= SAMPLES + 1 && 0 == udp.mErrors) && passed;
+
+    passed = stall() && passed;
+    passed = padding() && passed;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <unistd.h>
+#include <periodic_thread.h>
+
+
+class ControlLoop : public PeriodicThread<ControlLoop>
+{
+public:
+    ControlLoop(const int64_t period, const OverrunPolicy policy, const int slowEvery)
+    : PeriodicThread<ControlLoop>(period, policy), mSlowEvery(slowEvery), mCounter(0)
+    {
+    }
+
+    void cycle()
+    {
+        // every few cycles take longer than two periods to provoke overruns.
+        if (0 != mSlowEvery && 0 == ++mCounter % mSlowEvery)
+        {
+            usleep(static_cast<useconds_t>(getPeriod() / 400));
+        }
+    }
+
+    void print(const char* name) const
+    {
+        printf("%s: cycles %lu, overruns %lu, skipped %lu \n", name, getCycles(), getOverruns(), getSkipped());
+        printf("  jitter mean %.0f ns, p99 %lu ns, max %lu ns \n", getJitter().getMean(), getJitter().getPercentile(0.99), getJitter().getMax());
+        printf("  cycle mean %.0f ns, p99 %lu ns, max %lu ns \n", getCycleTime().getMean(), getCycleTime().getPercentile(0.99), getCycleTime().getMax());
+    }
+
+private:
+    int mSlowEvery;
+    int mCounter;
+};
+
+/**
+ * Runs a loop until it completes at least @p cycles cycles, however long it takes.
+ */
+static void run(ControlLoop& loop, const uint64_t cycles)
+{
+    loop.startThread();
+    while (loop.getCycles() < cycles)
+    {
+        usleep(10000);
+    }
+    loop.stopThread();
+}
+
+int main()
+{
+    // 1 kHz, counts are checked instead of the wall-clock time, which depends on the load of the machine.
+    ControlLoop regular(1000000, OverrunPolicy::SKIP, 0);
+    run(regular, 100);
+    regular.print("Regular");
+
+    ControlLoop skipping(1000000, OverrunPolicy::SKIP, 10);
+    run(skipping, 100);
+    skipping.print("Skipping");
+
+    ControlLoop catchingUp(1000000, OverrunPolicy::CATCH_UP, 10);
+    run(catchingUp, 100);
+    catchingUp.print("Catching up");
+
+    // a slow cycle takes 2.5 periods, so it always overruns: skipping loses deadlines, catching up none.
+    bool ok = regular.getCycles() >= 100;
+    ok = ok && skipping.getOverruns() >= skipping.getCycles() / 10 && skipping.getSkipped() >= skipping.getOverruns();
+    ok = ok && catchingUp.getOverruns() >= catchingUp.getCycles() / 10 && 0 == catchingUp.getSkipped();
+
+    // a period that is not positive is rejected instead of spinning or dividing by zero.
+    ControlLoop zero(0, OverrunPolicy::SKIP, 0);
+    ControlLoop negative(-1000000, OverrunPolicy::CATCH_UP, 0);
+    ok = ok && !zero.startThread() && !negative.startThread(ThreadConfig()) && 0 == zero.getCycles() && 0 == negative.getCycles();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <atomic>
+#include <cstdio>
+#include <unistd.h>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <pipeline_stage.h>
+
+
+static const int FRAMES = 50;
+
+class Source : public GenericTalker<int>
+{
+public:
+    void publish(const int value)
+    {
+        notifyListeners(value);
+    }
+};
+
+/**
+ * Adds one to its input after waiting for @p delay microseconds, like a stage waiting for a device.
+ */
+class DelayStage : public PipelineStage<int, int>
+{
+public:
+    DelayStage(const useconds_t delay, const size_t capacity, const OverflowPolicy policy, ThreadPool* pool = nullptr)
+    : PipelineStage<int, int>(capacity, policy, pool), mDelay(delay)
+    {
+    }
+
+    virtual ~DelayStage()
+    {
+        stop();
+    }
+
+protected:
+    void process(const int& input) override
+    {
+        usleep(mDelay);
+        notifyListeners(input + 1);
+    }
+
+private:
+    const useconds_t mDelay;
+};
+
+class Sink : public GenericListener<int>
+{
+public:
+    Sink() : mCount(0), mLast(-1), mErrors(0) {}
+
+    void update(const int& value) override
+    {
+        mErrors += (value <= mLast) ? 1 : 0;
+        mLast = value;
+        mCount.fetch_add(1, std::memory_order_release);
+    }
+
+    std::atomic<int> mCount;
+    int mLast;
+    int mErrors;
+};
+
+/**
+ * Pushes FRAMES inputs through three stages of 2 ms each.
+ *  @return the time it took in microseconds, or -1 on an error.
+ */
+static long runPipeline(const OverflowPolicy policy, const size_t capacity, ThreadPool* pool, Sink& sink)
+{
+    Source source;
+    DelayStage first(2000, capacity, policy, pool);
+    DelayStage second(2000, capacity, policy, pool);
+    DelayStage third(2000, capacity, policy, pool);
+    source.registerTo(&first);
+    first.connectTo(&second);
+    second.connectTo(&third);
+    third.connectTo(&sink);
+
+    int64_t start = monotonicNow();
+    for (int i = 0; i < FRAMES; ++i)
+    {
+        source.publish(i * 10);
+    }
+    first.stop();
+    second.stop();
+    third.stop();
+    return static_cast<long>((monotonicNow() - start) / 1000);
+}
+
+int main()
+{
+    bool ok = true;
+    {
+        // backpressure: small queues block the source, but no input is lost.
+        Sink sink;
+        long elapsed = runPipeline(OverflowPolicy::BLOCK, 2, nullptr, sink);
+        printf("Threads, blocking: %d outputs, %d errors in %ld us \n", sink.mCount.load(), sink.mErrors, elapsed);
+        // stages overlap, so it takes about FRAMES stage times rather than three times as much; only printed,
+        // as the time depends on the load of the machine.
+        ok = ok && FRAMES == sink.mCount.load() && 0 == sink.mErrors && (FRAMES - 1) * 10 + 3 == sink.mLast;
+    }
+    {
+        ThreadPool pool(3);
+        Sink sink;
+        long elapsed = runPipeline(OverflowPolicy::BLOCK, 2, &pool, sink);
+        printf("Pool, blocking: %d outputs, %d errors in %ld us \n", sink.mCount.load(), sink.mErrors, elapsed);
+        ok = ok && FRAMES == sink.mCount.load() && 0 == sink.mErrors && (FRAMES - 1) * 10 + 3 == sink.mLast;
+    }
+    {
+        // a pool with a single worker, which is blocked by its own publishing.
+        ThreadPool pool(1);
+        Sink sink;
+        runPipeline(OverflowPolicy::BLOCK, 1, &pool, sink);
+        printf("Single worker, blocking: %d outputs, %d errors \n", sink.mCount.load(), sink.mErrors);
+        ok = ok && FRAMES == sink.mCount.load() && 0 == sink.mErrors;
+    }
+    {
+        // conflation: the source never waits and the last input always gets through. Usually most inputs
+        // are conflated, but how many depends on the scheduling, so only the order and the last input are checked.
+        Sink sink;
+        long elapsed = runPipeline(OverflowPolicy::DROP_OLDEST, 1, nullptr, sink);
+        printf("Threads, conflating: %d outputs, last %d in %ld us \n", sink.mCount.load(), sink.mLast, elapsed);
+        ok = ok && sink.mCount.load() <= FRAMES && 0 == sink.mErrors && (FRAMES - 1) * 10 + 3 == sink.mLast;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <generic_listener.h>
+#include <generic_talker.h>
+
+
+class MyTalker : public GenericTalker<int>
+{
+public:
+    explicit MyTalker(const BroadcastMode mode) : GenericTalker<int>(mode) {}
+
+    void publish(const int value)
+    {
+        notifyListeners(value);
+    }
+
+    void publish(const uint64_t key, const int value)
+    {
+        notifyListenersByKey(key, value);
+    }
+};
+
+/**
+ * Appends its id to a shared list, to check the order of updates.
+ */
+class OrderListener : public GenericListener<int>
+{
+public:
+    OrderListener(std::vector<int>& order, const int id) : mOrder(order), mId(id) {}
+
+    void update(const int&) override
+    {
+        mOrder.push_back(mId);
+    }
+
+    std::vector<int>& mOrder;
+    const int mId;
+};
+
+/**
+ * Takes longer than its budget and checks that updates arrive in order.
+ */
+class SlowListener : public GenericListener<int>
+{
+public:
+    SlowListener() : mNext(0), mErrors(0) {}
+
+    void update(const int& value) override
+    {
+        usleep(2000);
+        mErrors += (value != mNext) ? 1 : 0;
+        mNext = value + 1;
+    }
+
+    std::atomic<int> mNext;
+    int mErrors;
+};
+
+/**
+ * Takes longer than its budget and uses the talker from within its update: it queries the
+ * talker, which takes its lock, and unregisters itself once it received a given value.
+ */
+class UnregisteringListener : public GenericListener<int>
+{
+public:
+    UnregisteringListener(MyTalker& talker, const int last) : mTalker(talker), mLast(last), mReceived(0), mOverlaps(0), mBusy(false) {}
+
+    void update(const int& value) override
+    {
+        mOverlaps += mBusy.exchange(true) ? 1 : 0;
+        usleep(2000);
+        if (value >= 0)
+        {
+            // only for updates of mTalker: its publisher holds the lock of the talker before the update lock.
+            mTalker.getOverruns(this);
+        }
+        if (value == mLast)
+        {
+            mTalker.unregisterFrom(this);
+        }
+        mReceived.fetch_add(1);
+        mBusy.store(false);
+    }
+
+    MyTalker& mTalker;
+    const int mLast;
+    std::atomic<int> mReceived;
+    int mOverlaps;
+    std::atomic<bool> mBusy;
+};
+
+static bool checkOrder(const BroadcastMode mode)
+{
+    std::vector<int> order;
+    MyTalker talker(mode);
+    OrderListener logger(order, 0);
+    OrderListener plain(order, 1);
+    OrderListener critical(order, 2);
+    OrderListener keyed(order, 3);
+    OrderListener filtered(order, 4);
+    talker.registerTo(&logger, DispatchOptions{-1});
+    talker.registerTo(&plain);
+    talker.registerTo(&critical, DispatchOptions{10});
+    talker.registerTo(&keyed, static_cast<uint64_t>(7));
+    talker.registerTo(&keyed, DispatchOptions{5});
+    talker.registerTo(&filtered, [](const int& value) { return value > 0; });
+    talker.registerTo(&filtered, DispatchOptions{1});
+
+    talker.publish(static_cast<uint64_t>(7), 1);
+    talker.publish(0);
+    const std::vector<int> expected = {2, 3, 4, 1, 0, 2, 1, 0};
+    return expected == order;
+}
+
+static bool checkIsolation(const BroadcastMode mode)
+{
+    MyTalker talker(mode);
+    SlowListener slow;
+    std::vector<int> order;
+    OrderListener critical(order, 1);
+    DispatchOptions options;
+    options.mBudget = 500000;
+    options.mIsolateAfter = 3;
+    talker.registerTo(&slow, options);
+    talker.registerTo(&critical);
+
+    int64_t lastPublish = 0;
+    for (int i = 0; i < 20; ++i)
+    {
+        int64_t start = monotonicNow();
+        talker.publish(i);
+        lastPublish = monotonicNow() - start;
+    }
+    bool isolated = talker.isIsolated(&slow);
+    uint64_t overruns = talker.getOverruns(&slow);
+    // unregistering delivers the updates still queued.
+    talker.unregisterFrom(&slow);
+    printf("Mode %d: isolated %d after %lu overruns, last publish %ld us, slow received %d with %d errors \n",
+           static_cast<int>(mode), isolated, overruns, lastPublish / 1000, slow.mNext.load(), slow.mErrors);
+    return isolated && 3 == overruns && lastPublish < 1000000 && 20 == slow.mNext.load() && 0 == slow.mErrors && 20 == static_cast<int>(order.size());
+}
+
+/**
+ * Unregisters isolated listeners from within their updates made by the asynchronous thread,
+ * and from the publishing thread while such an update waits for the lock of the talker.
+ */
+static bool checkUnregistration(const BroadcastMode mode)
+{
+    MyTalker talker(mode);
+    UnregisteringListener itself(talker, 10);
+    UnregisteringListener other(talker, -1);
+    DispatchOptions options;
+    options.mBudget = 500000;
+    options.mIsolateAfter = 3;
+    talker.registerTo(&itself, options);
+    talker.registerTo(&other, options);
+    // a concurrent talker updates the listener under the same lock as its asynchronous thread.
+    MyTalker concurrent(BroadcastMode::CONCURRENT);
+    concurrent.registerTo(&other);
+
+    std::thread publisher([&concurrent]()
+    {
+        for (int i = 0; i < 20; ++i)
+        {
+            concurrent.publish(-2);
+        }
+    });
+    for (int i = 0; i < 20; ++i)
+    {
+        talker.publish(i);
+    }
+    publisher.join();
+    bool isolated = talker.isIsolated(&itself) || 11 == itself.mReceived.load();
+    // the asynchronous thread of this listener may be querying the talker meanwhile.
+    talker.unregisterFrom(&other);
+    int otherReceived = other.mReceived.load();
+    for (int i = 0; i < 2000 && 11 > itself.mReceived.load(); ++i)
+    {
+        usleep(1000);
+    }
+    usleep(20000);
+    printf("Mode %d: isolated %d, unregistered itself after %d updates, other received %d, %d overlapping updates \n",
+           static_cast<int>(mode), isolated, itself.mReceived.load(), otherReceived, itself.mOverlaps + other.mOverlaps);
+    return isolated && 11 == itself.mReceived.load() && 40 == otherReceived && 0 == itself.mOverlaps + other.mOverlaps;
+}
+
+int main()
+{
+    bool ok = true;
+    for (BroadcastMode mode : {BroadcastMode::EXCLUSIVE, BroadcastMode::SNAPSHOT, BroadcastMode::CONCURRENT})
+    {
+        bool ordered = checkOrder(mode);
+        printf("Mode %d: order %s \n", static_cast<int>(mode), ordered ? "OK" : "FAILED");
+        ok = ordered && checkIsolation(mode) && ok;
+        ok = checkUnregistration(mode) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <atomic>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <reactor.h>
+
+
+static const int VALUES = 1000;
+
+/**
+ * Reads integers from a pipe and broadcasts them.
+ */
+class PipeTalker : public GenericTalker<int>, public ReactorHandler
+{
+public:
+    void handleEvents(const int fd, const uint64_t events) override
+    {
+        int values[64];
+        ssize_t size = 0;
+        while ((events & EPOLLIN) && (size = read(fd, values, sizeof(values))) > 0)
+        {
+            for (ssize_t i = 0; i < size / static_cast<ssize_t>(sizeof(int)); ++i)
+            {
+                notifyListeners(values[i]);
+            }
+        }
+    }
+};
+
+class SummingListener : public GenericListener<int>
+{
+public:
+    SummingListener() : mCount(0), mSum(0) {}
+
+    void update(const int& value) override
+    {
+        mSum.fetch_add(value, std::memory_order_relaxed);
+        mCount.fetch_add(1, std::memory_order_release);
+    }
+
+    std::atomic<int> mCount;
+    std::atomic<long> mSum;
+};
+
+/**
+ * Counts events and optionally removes its source from the reactor on the first call.
+ */
+class CountingHandler : public ReactorHandler
+{
+public:
+    CountingHandler(Reactor& reactor, const bool removeSelf) : mReactor(reactor), mRemoveSelf(removeSelf), mCalls(0), mEvents(0) {}
+
+    void handleEvents(const int fd, const uint64_t events) override
+    {
+        mEvents.fetch_add(events, std::memory_order_relaxed);
+        mCalls.fetch_add(1, std::memory_order_release);
+        if (mRemoveSelf)
+        {
+            mReactor.remove(fd);
+        }
+    }
+
+    Reactor& mReactor;
+    const bool mRemoveSelf;
+    std::atomic<int> mCalls;
+    std::atomic<uint64_t> mEvents;
+};
+
+int main()
+{
+    Reactor reactor;
+    PipeTalker pipeTalker;
+    SummingListener listener;
+    CountingHandler periodic(reactor, false);
+    CountingHandler oneShot(reactor, true);
+    CountingHandler wakeup(reactor, false);
+    int fds[2];
+    bool ok = reactor.isOpen() && 0 == pipe2(fds, O_NONBLOCK);
+
+    pipeTalker.registerTo(&listener);
+    ok = ok && reactor.add(fds[0], EPOLLIN, &pipeTalker) && !reactor.add(fds[0], EPOLLIN, &pipeTalker);
+    int periodicFd = reactor.addTimer(&periodic, 5000000, 5000000);
+    int oneShotFd = reactor.addTimer(&oneShot, 1000000, 1000000);
+    int wakeupFd = reactor.addWakeup(&wakeup);
+    ok = ok && periodicFd >= 0 && oneShotFd >= 0 && wakeupFd >= 0 && reactor.startThread();
+
+    long expected = 0;
+    for (int i = 0; i < VALUES; ++i)
+    {
+        ok = ok && sizeof(i) == write(fds[1], &i, sizeof(i));
+        expected += i;
+    }
+    for (int i = 0; i < 100; ++i)
+    {
+        ok = ok && reactor.notify(wakeupFd);
+    }
+    while (listener.mCount.load(std::memory_order_acquire) < VALUES || wakeup.mEvents.load(std::memory_order_relaxed) < 100)
+    {
+        usleep(1000);
+    }
+    usleep(60000);
+
+    // once remove returns from another thread, the handler is not called anymore.
+    ok = ok && reactor.remove(periodicFd) && !reactor.remove(periodicFd) && !reactor.remove(oneShotFd);
+    int periodicCalls = periodic.mCalls.load(std::memory_order_acquire);
+    usleep(20000);
+    printf("Pipe: %d values, sum %ld \n", listener.mCount.load(), listener.mSum.load());
+    printf("Timers: periodic %d calls, %lu expirations, one-shot %d calls \n", periodicCalls,
+           periodic.mEvents.load(), oneShot.mCalls.load());
+    printf("Wake-up: %d calls, %lu notifications \n", wakeup.mCalls.load(), wakeup.mEvents.load());
+    ok = ok && expected == listener.mSum.load() && periodic.mEvents.load() >= 8 && periodicCalls == periodic.mCalls.load();
+    ok = ok && 1 == oneShot.mCalls.load() && 100 == wakeup.mEvents.load() && wakeup.mCalls.load() <= 100;
+
+    reactor.stopThread();
+    ok = ok && !reactor.isRunning() && reactor.remove(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <stream_recorder.h>
+
+
+static const int SAMPLES = 10000;
+
+struct ImuSample
+{
+    long mSequence;
+    double mAcceleration[3];
+};
+
+class ImuTalker : public GenericTalker<ImuSample>
+{
+public:
+    void publish(const ImuSample& sample)
+    {
+        notifyListeners(sample);
+    }
+
+    void publish(const ImuSample* samples, const size_t count)
+    {
+        notifyListenersBatch(samples, count);
+    }
+};
+
+class CounterTalker : public GenericTalker<int>
+{
+public:
+    void publish(const int value)
+    {
+        notifyListeners(value);
+    }
+};
+
+class ImuListener : public GenericListener<ImuSample>
+{
+public:
+    ImuListener() : mNext(0), mErrors(0) {}
+
+    void update(const ImuSample& sample) override
+    {
+        mErrors += (sample.mSequence != mNext || sample.mAcceleration[2] != static_cast<double>(sample.mSequence)) ? 1 : 0;
+        mNext = sample.mSequence + 1;
+    }
+
+    long mNext;
+    long mErrors;
+};
+
+class CounterListener : public GenericListener<int>
+{
+public:
+    CounterListener() : mCount(0), mSum(0) {}
+
+    void update(const int& value) override
+    {
+        ++mCount;
+        mSum += value;
+    }
+
+    int mCount;
+    long mSum;
+};
+
+/**
+ * Replays the whole recording and waits for the end.
+ *  @return the time the replay took in nanoseconds.
+ */
+static int64_t replay(StreamReplayer& replayer)
+{
+    int64_t start = monotonicNow();
+    replayer.startThread();
+    while (!replayer.isFinished())
+    {
+        usleep(1000);
+    }
+    replayer.stopThread();
+    return monotonicNow() - start;
+}
+
+int main()
+{
+    const std::string path = "/tmp/utils_test_recorder_" + std::to_string(getpid()) + ".rec";
+    int64_t middle = 0;
+    bool ok = true;
+    {
+        // a small initial size makes the file grow several times.
+        RecordWriter writer(path, 4096);
+        StreamRecorder<ImuSample> imuRecorder(writer, 1);
+        StreamRecorder<int> counterRecorder(writer, 2);
+        ImuTalker imuTalker;
+        CounterTalker counterTalker;
+        imuTalker.registerTo(&imuRecorder);
+        counterTalker.registerTo(&counterRecorder);
+        ok = writer.isOpen();
+
+        ImuSample batch[10] = {};
+        for (int i = 0; i < SAMPLES; i += 10)
+        {
+            for (int j = 0; j < 10; ++j)
+            {
+                batch[j].mSequence = i + j;
+                batch[j].mAcceleration[2] = static_cast<double>(i + j);
+            }
+            imuTalker.publish(batch, 10);
+            counterTalker.publish(i);
+            if (SAMPLES / 2 == i)
+            {
+                middle = monotonicNow();
+            }
+        }
+        // the last samples are spread in time to check the pace of the replay.
+        for (int i = 0; i < 5; ++i)
+        {
+            usleep(20000);
+            batch[0].mSequence = SAMPLES + i;
+            batch[0].mAcceleration[2] = static_cast<double>(SAMPLES + i);
+            imuTalker.publish(batch[0]);
+        }
+        printf("Recorded %lu records \n", writer.getCount());
+        ok = ok && static_cast<uint64_t>(SAMPLES + SAMPLES / 10 + 5) == writer.getCount();
+    }
+
+    {
+        StreamReplayer replayer(path);
+        ReplayTalker<ImuSample> imuTalker;
+        ReplayTalker<int> counterTalker;
+        ImuListener imuListener;
+        CounterListener counterListener;
+        imuTalker.registerTo(&imuListener);
+        counterTalker.registerTo(&counterListener);
+        replayer.addChannel(1, &imuTalker);
+        replayer.addChannel(2, &counterTalker);
+        replayer.setSpeed(0.0);
+        ok = ok && replayer.isOpen() && SAMPLES + SAMPLES / 10 + 5 == static_cast<int>(replayer.getFileHeader().mCount);
+        int64_t elapsed = replay(replayer);
+        printf("Fast replay: %lu records, %ld errors, %d counters in %ld us \n",
+               replayer.getReplayed(), imuListener.mErrors, counterListener.mCount, elapsed / 1000);
+        ok = ok && SAMPLES + 5 == imuListener.mNext && 0 == imuListener.mErrors;
+        ok = ok && SAMPLES / 10 == counterListener.mCount && 4995000 == counterListener.mSum;
+
+        // the second half of the recording, found through the index, at twice the recorded pace.
+        ok = ok && replayer.seek(middle);
+        imuListener.mNext = SAMPLES / 2 + 10;
+        replayer.setSpeed(2.0);
+        elapsed = replay(replayer);
+        printf("Replay from the middle: next %ld, errors %ld in %ld us \n", imuListener.mNext, imuListener.mErrors, elapsed / 1000);
+        ok = ok && SAMPLES + 5 == imuListener.mNext && 0 == imuListener.mErrors && elapsed >= 45000000;
+        ok = ok && !replayer.seek(monotonicNow());
+    }
+
+    {
+        // records of channels without a talker are skipped.
+        StreamReplayer replayer(path);
+        CounterListener counterListener;
+        ReplayTalker<int> counterTalker;
+        counterTalker.registerTo(&counterListener);
+        replayer.addChannel(2, &counterTalker);
+        replayer.setSpeed(0.0);
+        replay(replayer);
+        printf("Channel 2 only: %lu replayed, %lu skipped \n", replayer.getReplayed(), replayer.getSkipped());
+        ok = ok && SAMPLES / 10 == static_cast<int>(replayer.getReplayed()) && SAMPLES + 5 == static_cast<int>(replayer.getSkipped());
+    }
+
+    unlink(path.c_str());
+    unlink((path + ".idx").c_str());
+    return ok ? 0 : 1;
+}
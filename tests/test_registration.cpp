@@ -0,0 +1,211 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <vector>
+#include <generic_listener.h>
+#include <generic_talker.h>
+
+
+class CountingListener : public GenericListener<int>
+{
+public:
+    CountingListener() : mCounter(0) {}
+
+    void update(const int&) override
+    {
+        ++mCounter;
+    }
+
+    int mCounter;
+};
+
+class OrderListener : public GenericListener<int>
+{
+public:
+    OrderListener() : mId(0), mOrder(nullptr) {}
+
+    void update(const int&) override
+    {
+        mOrder->push_back(mId);
+    }
+
+    int mId;
+    std::vector<int>* mOrder;
+};
+
+class MyTalker;
+
+class UnregisteringListener : public CountingListener
+{
+public:
+    UnregisteringListener() : mTalker(nullptr), mOther(nullptr) {}
+
+    void update(const int& value) override;
+
+    MyTalker* mTalker;
+    GenericListener<int>* mOther;
+};
+
+class MyTalker : public GenericTalker<int>
+{
+public:
+    using GenericTalker<int>::GenericTalker;
+
+    void publish(const int value)
+    {
+        notifyListeners(value);
+    }
+};
+
+void UnregisteringListener::update(const int& value)
+{
+    CountingListener::update(value);
+    mTalker->unregisterFrom(mOther);
+}
+
+static bool runTest(const char* name, const BroadcastMode mode)
+{
+    const size_t count = 10000;
+    std::vector<CountingListener> listeners(count);
+    bool ok = true;
+    {
+        MyTalker talker(mode);
+        for (CountingListener& listener : listeners)
+        {
+            talker.registerTo(&listener);
+            // registering twice must not duplicate the listener.
+            talker.registerTo(&listener);
+        }
+        // unregister every third listener, some of them from the listener side.
+        for (size_t i = 0; i < count; i += 3)
+        {
+            if (0 == i % 2)
+            {
+                talker.unregisterFrom(&listeners[i]);
+            }
+            else
+            {
+                listeners[i].unregisterFrom(&talker);
+            }
+        }
+        talker.publish(1);
+        for (size_t i = 0; i < count; ++i)
+        {
+            ok = ok && listeners[i].mCounter == (0 == i % 3 ? 0 : 1);
+        }
+        // unregistered listeners can register again.
+        talker.registerTo(&listeners[0]);
+        talker.publish(2);
+        ok = ok && 1 == listeners[0].mCounter && 2 == listeners[1].mCounter && 0 == listeners[3].mCounter;
+    }
+    // the talker was destroyed, so no listener can have it registered anymore.
+    MyTalker other(mode);
+    for (CountingListener& listener : listeners)
+    {
+        other.registerTo(&listener);
+    }
+    other.publish(3);
+    ok = ok && 1 == listeners[3].mCounter && 3 == listeners[1].mCounter;
+    printf("%s: %s \n", name, ok ? "passed" : "failed");
+    return ok;
+}
+
+static bool runOrderTest(const char* name, const BroadcastMode mode)
+{
+    std::vector<int> order;
+    std::vector<OrderListener> listeners(6);
+    MyTalker talker(mode);
+    for (size_t i = 0; i < listeners.size(); ++i)
+    {
+        listeners[i].mId = static_cast<int>(i);
+        listeners[i].mOrder = &order;
+    }
+    for (size_t i = 0; i < 5; ++i)
+    {
+        talker.registerTo(&listeners[i]);
+    }
+    // removing listeners from the middle and from the end keeps the order of the others.
+    talker.unregisterFrom(&listeners[1]);
+    listeners[3].unregisterFrom(&talker);
+    talker.unregisterFrom(&listeners[4]);
+    talker.publish(1);
+    bool ok = (std::vector<int>{0, 2} == order);
+    // new listeners go to the end, also after a listener registers again.
+    order.clear();
+    talker.registerTo(&listeners[5]);
+    talker.registerTo(&listeners[1]);
+    talker.unregisterFrom(&listeners[0]);
+    talker.publish(2);
+    ok = ok && (std::vector<int>{2, 5, 1} == order);
+    printf("%s order: %s \n", name, ok ? "passed" : "failed");
+    return ok;
+}
+
+static bool runNestedTest(const char* name, const BroadcastMode mode, const bool subscribed)
+{
+    std::vector<CountingListener> listeners(4);
+    UnregisteringListener first;
+    MyTalker talker(mode);
+    first.mTalker = &talker;
+    first.mOther = &listeners[1];
+    const auto positive = [](const int value) { return value > 0; };
+    if (subscribed)
+    {
+        // routed listeners are updated in the order they registered as well.
+        talker.registerTo(&first, positive);
+        for (CountingListener& listener : listeners)
+        {
+            talker.registerTo(&listener, positive);
+        }
+    }
+    else
+    {
+        talker.registerTo(&first);
+        for (CountingListener& listener : listeners)
+        {
+            talker.registerTo(&listener);
+        }
+    }
+    // the first listener unregisters a later one from within its update, then the last one.
+    talker.publish(1);
+    bool ok = 1 == first.mCounter && 1 == listeners[0].mCounter && 0 == listeners[1].mCounter && 1 == listeners[3].mCounter;
+    first.mOther = &listeners[3];
+    talker.publish(2);
+    ok = ok && 2 == listeners[0].mCounter && 0 == listeners[1].mCounter && 2 == listeners[2].mCounter && 1 == listeners[3].mCounter;
+    // the gaps left by both listeners do not disturb later broadcasts.
+    talker.publish(3);
+    ok = ok && 3 == first.mCounter && 3 == listeners[2].mCounter && 1 == listeners[3].mCounter;
+    printf("%s nested%s: %s \n", name, subscribed ? " subscribed" : "", ok ? "passed" : "failed");
+    return ok;
+}
+
+int main()
+{
+    bool ok = runTest("Exclusive", BroadcastMode::EXCLUSIVE);
+    ok = runTest("Snapshot", BroadcastMode::SNAPSHOT) && ok;
+    ok = runOrderTest("Exclusive", BroadcastMode::EXCLUSIVE) && ok;
+    ok = runOrderTest("Snapshot", BroadcastMode::SNAPSHOT) && ok;
+    ok = runNestedTest("Exclusive", BroadcastMode::EXCLUSIVE, false) && ok;
+    ok = runNestedTest("Exclusive", BroadcastMode::EXCLUSIVE, true) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cstdio>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <shm_transport.h>
+
+
+static const char* SEGMENT = "/utils_test_shm_transport";
+static const long SAMPLES = 100000;
+
+struct ImuSample
+{
+    long mSequence;
+    double mAcceleration[3];
+    double mAngularVelocity[3];
+};
+
+class ImuTalker : public GenericTalker<ImuSample>
+{
+public:
+    void publish(const ImuSample& sample)
+    {
+        notifyListeners(sample);
+    }
+};
+
+class CheckingListener : public GenericListener<ImuSample>
+{
+public:
+    CheckingListener() : mReceived(0), mErrors(0), mDone(false) {}
+
+    void update(const ImuSample& sample) override
+    {
+        if (sample.mSequence < 0)
+        {
+            mDone.store(true, std::memory_order_release);
+            return;
+        }
+        if (sample.mSequence != mReceived || sample.mAcceleration[2] != static_cast<double>(sample.mSequence))
+        {
+            ++mErrors;
+        }
+        ++mReceived;
+    }
+
+    long mReceived;
+    long mErrors;
+    std::atomic<bool> mDone;
+};
+
+/**
+ * Runs in a child process and receives all samples.
+ */
+static int receive()
+{
+    // the listener is registered before attaching, as the parent starts publishing once it sees the reader.
+    CheckingListener listener;
+    ShmReceiver<ImuSample> receiver(SEGMENT, &listener);
+    if (!receiver.isOpen())
+    {
+        puts("Receiver could not attach");
+        return 1;
+    }
+    while (!listener.mDone.load(std::memory_order_acquire))
+    {
+        usleep(1000);
+    }
+    printf("Child received %ld samples with %ld errors \n", listener.mReceived, listener.mErrors);
+    fflush(stdout);
+    return (SAMPLES == listener.mReceived && 0 == listener.mErrors) ? 0 : 1;
+}
+
+int main()
+{
+    ShmPublisher<ImuSample> publisher(SEGMENT, 256);
+    if (!publisher.isOpen())
+    {
+        puts("Could not create the shared memory segment");
+        return 1;
+    }
+
+    pid_t child = fork();
+    if (0 == child)
+    {
+        _exit(receive());
+    }
+    while (0 == publisher.getReaderCount())
+    {
+        usleep(1000);
+    }
+
+    // the first sample goes through a local talker, to which the publisher is an ordinary listener.
+    ImuTalker talker;
+    talker.registerTo(&publisher);
+    ImuSample sample = {};
+    talker.publish(sample);
+    talker.unregisterFrom(&publisher);
+
+    // the receiver is allowed to lag behind, so dropped samples are resent to check all of them.
+    long retries = 0;
+    for (long i = 1; i < SAMPLES; ++i)
+    {
+        sample.mSequence = i;
+        sample.mAcceleration[2] = static_cast<double>(i);
+        while (!publisher.publish(sample))
+        {
+            ++retries;
+            sched_yield();
+        }
+    }
+    sample.mSequence = -1;
+    while (!publisher.publish(sample))
+    {
+        sched_yield();
+    }
+
+    int status = 1;
+    waitpid(child, &status, 0);
+    printf("Parent published %ld samples, %ld retries \n", SAMPLES, retries);
+    return (WIFEXITED(status) && 0 == WEXITSTATUS(status)) ? 0 : 1;
+}
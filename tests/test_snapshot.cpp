@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cstdio>
+#include <unistd.h>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <generic_thread.h>
+
+
+class CountingListener : public GenericListener<int>
+{
+public:
+    CountingListener() : mCounter(0), mAttached(false), mErrors(0) {}
+
+    void update(const int&) override
+    {
+        if (!mAttached.load(std::memory_order_acquire))
+        {
+            mErrors.fetch_add(1);
+        }
+        mCounter.fetch_add(1);
+    }
+
+    std::atomic<int> mCounter;
+    std::atomic<bool> mAttached;
+    std::atomic<int> mErrors;
+};
+
+class SnapshotTalker : public GenericTalker<int>, public GenericThread<SnapshotTalker>
+{
+public:
+    SnapshotTalker() : GenericTalker<int>(BroadcastMode::SNAPSHOT), GenericThread<SnapshotTalker>(), mPublished(0) {}
+
+    void* threadBody()
+    {
+        while (isRunning())
+        {
+            notifyListeners(++mPublished);
+        }
+        return nullptr;
+    }
+
+    void publish(const int value)
+    {
+        notifyListeners(value);
+    }
+
+    int mPublished;
+};
+
+/**
+ * Listener that unregisters itself from within its own update.
+ */
+class OneShotListener : public GenericListener<int>
+{
+public:
+    explicit OneShotListener(GenericTalker<int>& talker) : mTalker(talker), mCounter(0) {}
+
+    void update(const int&) override
+    {
+        ++mCounter;
+        unregisterFrom(&mTalker);
+    }
+
+    GenericTalker<int>& mTalker;
+    std::atomic<int> mCounter;
+};
+
+int main()
+{
+    SnapshotTalker talker;
+    CountingListener listeners[8];
+    int errors = 0;
+
+    talker.startThread();
+    for (int cycle = 0; cycle < 1000; ++cycle)
+    {
+        for (CountingListener& listener : listeners)
+        {
+            listener.mAttached.store(true, std::memory_order_release);
+            talker.registerTo(&listener);
+        }
+        for (CountingListener& listener : listeners)
+        {
+            talker.unregisterFrom(&listener);
+            // after unregisterFrom returns no broadcast may reach the listener anymore.
+            listener.mAttached.store(false, std::memory_order_release);
+        }
+    }
+    usleep(1000);
+    talker.stopThread();
+
+    for (const CountingListener& listener : listeners)
+    {
+        errors += listener.mErrors.load();
+    }
+    printf("Published: %d, late updates: %d \n", talker.mPublished, errors);
+
+    OneShotListener oneShot(talker);
+    talker.registerTo(&oneShot);
+    for (int i = 0; i < 3; ++i)
+    {
+        talker.publish(i);
+    }
+    printf("One shot listener called %d time(s) \n", oneShot.mCounter.load());
+
+    // a listener unregistering itself from within its update while another thread registers
+    // and unregisters listeners on the same talker must not dead-lock either of them.
+    SnapshotTalker busy;
+    OneShotListener selfRemoving(busy);
+    CountingListener other;
+    busy.startThread();
+    // cycles go on until the listener was updated at least once, as the thread may start late.
+    for (int cycle = 0; cycle < 1000 || 0 == selfRemoving.mCounter.load(); ++cycle)
+    {
+        busy.registerTo(&selfRemoving);
+        busy.registerTo(&other);
+        busy.unregisterFrom(&other);
+    }
+    busy.stopThread();
+    printf("Self unregistering listener called %d time(s) \n", selfRemoving.mCounter.load());
+
+    return (0 == errors && 1 == oneShot.mCounter.load() && selfRemoving.mCounter.load() > 0) ? 0 : 1;
+}
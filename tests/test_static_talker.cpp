@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <string>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <static_talker.h>
+
+
+/**
+ * A plain class with an update method.
+ */
+class Accumulator
+{
+public:
+    Accumulator() : mSum(0), mOrder(0) {}
+
+    void update(const int& value, const std::string&)
+    {
+        mSum += value;
+        mOrder = ++sCalls;
+    }
+
+    int mSum;
+    int mOrder;
+    static inline int sCalls = 0;
+};
+
+/**
+ * A generic listener can be used too; final lets the compiler skip the virtual call.
+ */
+class Printer final : public GenericListener<int, std::string>
+{
+public:
+    Printer() : mLast() {}
+
+    void update(const int&, const std::string& text) override
+    {
+        mLast = text;
+        mOrder = ++Accumulator::sCalls;
+    }
+
+    std::string mLast;
+    int mOrder;
+};
+
+class Pipeline : public StaticTalker<Accumulator, Printer>
+{
+public:
+    using StaticTalker::StaticTalker;
+
+    void publish(const int value)
+    {
+        notifyListeners(value, std::to_string(value));
+    }
+};
+
+int main()
+{
+    Accumulator accumulator;
+    Printer printer;
+    Pipeline pipeline(accumulator, printer);
+    for (int i = 1; i <= 10; ++i)
+    {
+        pipeline.publish(i);
+    }
+    pipeline.pause();
+    pipeline.publish(100);
+    pipeline.resume();
+
+    printf("Sum %d, last text %s, order %d %d \n", accumulator.mSum, printer.mLast.c_str(), accumulator.mOrder, printer.mOrder);
+    // listeners are updated in the order they were given to the constructor.
+    bool ok = 55 == accumulator.mSum && "10" == printer.mLast && 19 == accumulator.mOrder && 20 == printer.mOrder;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <cstdio>
+#include <generic_listener.h>
+#include <generic_talker.h>
+
+
+static const int SENSORS = 100;
+
+struct Reading
+{
+    int mSensor;
+    double mValue;
+};
+
+class ReadingTalker : public GenericTalker<Reading>
+{
+public:
+    explicit ReadingTalker(const BroadcastMode mode) : GenericTalker<Reading>(mode) {}
+
+    /**
+     * Publishes one reading of every sensor with the value equal to the sensor id.
+     */
+    void publishAll()
+    {
+        for (int i = 0; i < SENSORS; ++i)
+        {
+            Reading reading = {i, static_cast<double>(i)};
+            notifyListenersByKey(static_cast<uint64_t>(i), reading);
+        }
+    }
+
+    void publish(const Reading& reading)
+    {
+        notifyListeners(reading);
+    }
+
+    void publish(const Reading* readings, const size_t count)
+    {
+        notifyListenersBatch(readings, count);
+    }
+};
+
+class CountingListener : public GenericListener<Reading>
+{
+public:
+    CountingListener() : mCount(0), mSum(0.0) {}
+
+    void update(const Reading& reading) override
+    {
+        ++mCount;
+        mSum += reading.mValue;
+    }
+
+    void reset()
+    {
+        mCount = 0;
+        mSum = 0.0;
+    }
+
+    int mCount;
+    double mSum;
+};
+
+/**
+ * Checks subscriptions with a talker broadcasting in the given mode.
+ */
+static bool check(const BroadcastMode mode)
+{
+    ReadingTalker talker(mode);
+    CountingListener all;
+    CountingListener sensor;
+    CountingListener high;
+    talker.registerTo(&all);
+    talker.registerTo(&sensor, static_cast<uint64_t>(7));
+    talker.registerTo(&high, [](const Reading& reading) { return reading.mValue >= 90.0; });
+
+    talker.publishAll();
+    bool ok = SENSORS == all.mCount && 1 == sensor.mCount && 7.0 == sensor.mSum && 10 == high.mCount && 945.0 == high.mSum;
+
+    // a broadcast without a key does not reach keyed listeners.
+    talker.publish(Reading{7, 95.0});
+    ok = ok && SENSORS + 1 == all.mCount && 1 == sensor.mCount && 11 == high.mCount;
+
+    // batches are filtered sample by sample.
+    Reading readings[4] = {{1, 1.0}, {2, 92.0}, {3, 3.0}, {4, 94.0}};
+    talker.publish(readings, 4);
+    ok = ok && SENSORS + 5 == all.mCount && 1 == sensor.mCount && 13 == high.mCount;
+
+    // registering again replaces the subscription, unregistering drops it.
+    sensor.reset();
+    talker.registerTo(&sensor, static_cast<uint64_t>(42));
+    talker.publishAll();
+    ok = ok && 1 == sensor.mCount && 42.0 == sensor.mSum;
+    high.unregisterFrom(&talker);
+    talker.registerTo(&high);
+    high.reset();
+    talker.publishAll();
+    ok = ok && SENSORS == high.mCount;
+
+    // a destroyed subscribed listener is not routed to anymore.
+    {
+        CountingListener temporary;
+        talker.registerTo(&temporary, static_cast<uint64_t>(42));
+        talker.publishAll();
+        ok = ok && 1 == temporary.mCount;
+    }
+    sensor.reset();
+    talker.publishAll();
+    ok = ok && 1 == sensor.mCount;
+    printf("Mode %d: %s \n", static_cast<int>(mode), ok ? "OK" : "FAILED");
+    return ok;
+}
+
+int main()
+{
+    bool ok = check(BroadcastMode::EXCLUSIVE);
+    ok = check(BroadcastMode::SNAPSHOT) && ok;
+    ok = check(BroadcastMode::CONCURRENT) && ok;
+    return ok ? 0 : 1;
+}
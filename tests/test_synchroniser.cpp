@@ -0,0 +1,256 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <time_synchroniser.h>
+
+
+static const int64_t MILLISECOND = 1000000;
+
+struct Image
+{
+    int64_t mStamp;
+    int mFrame;
+};
+
+struct Imu
+{
+    int64_t mStamp;
+    double mRate;
+};
+
+struct Odometry
+{
+    int64_t mStamp;
+    double mDistance;
+};
+
+template<typename T>
+class SensorTalker : public GenericTalker<T>
+{
+public:
+    void publish(const T& sample)
+    {
+        this->notifyListeners(sample);
+    }
+};
+
+static int64_t imageStamp(const Image& image)
+{
+    return image.mStamp;
+}
+
+static int64_t imuStamp(const Imu& imu)
+{
+    return imu.mStamp;
+}
+
+static int64_t odometryStamp(const Odometry& odometry)
+{
+    return odometry.mStamp;
+}
+
+class FusionListener : public GenericListener<Image, Imu, Odometry>
+{
+public:
+    FusionListener(const int64_t window) : mWindow(window), mMatched(0), mErrors(0), mLast(-1) {}
+
+    void update(const Image& image, const Imu& imu, const Odometry& odometry) override
+    {
+        int64_t oldest = std::min({image.mStamp, imu.mStamp, odometry.mStamp});
+        int64_t latest = std::max({image.mStamp, imu.mStamp, odometry.mStamp});
+        if (latest - oldest > mWindow || image.mStamp <= mLast)
+        {
+            ++mErrors;
+        }
+        mLast = image.mStamp;
+        mImuDistance.push_back(latest - imu.mStamp);
+        ++mMatched;
+    }
+
+    const int64_t mWindow;
+    long mMatched;
+    long mErrors;
+    int64_t mLast;
+    std::vector<int64_t> mImuDistance;
+};
+
+class PairListener : public GenericListener<Image, Odometry>
+{
+public:
+    PairListener() : mMatched(0), mErrors(0) {}
+
+    void update(const Image& image, const Odometry& odometry) override
+    {
+        if (image.mStamp != odometry.mStamp)
+        {
+            ++mErrors;
+        }
+        ++mMatched;
+    }
+
+    long mMatched;
+    long mErrors;
+};
+
+/**
+ * Matches identical timestamps, with every third odometry sample missing.
+ */
+static bool testExact()
+{
+    SensorTalker<Image> camera;
+    SensorTalker<Odometry> wheels;
+    TimeSynchroniser<Image, Odometry> synchroniser(0, 16, imageStamp, odometryStamp);
+    PairListener listener;
+    camera.registerTo(&synchroniser.getInput<0>());
+    wheels.registerTo(&synchroniser.getInput<1>());
+    synchroniser.registerTo(&listener);
+
+    for (int i = 0; i < 300; ++i)
+    {
+        camera.publish({i * 10 * MILLISECOND, i});
+        if (0 != i % 3)
+        {
+            wheels.publish({i * 10 * MILLISECOND, 0.1 * i});
+        }
+    }
+    printf("Exact: matched %ld of 300 with %ld errors \n", listener.mMatched, listener.mErrors);
+    return 200 == listener.mMatched && 0 == listener.mErrors;
+}
+
+/**
+ * Matches a 30 Hz camera with the closest sample of a 200 Hz IMU and a 50 Hz odometry.
+ */
+static bool testApproximate()
+{
+    SensorTalker<Image> camera;
+    SensorTalker<Imu> imu;
+    SensorTalker<Odometry> wheels;
+    TimeSynchroniser<Image, Imu, Odometry> synchroniser(12 * MILLISECOND, 64, imageStamp, imuStamp, odometryStamp);
+    FusionListener listener(12 * MILLISECOND);
+    camera.registerTo(&synchroniser.getInput<0>());
+    imu.registerTo(&synchroniser.getInput<1>());
+    wheels.registerTo(&synchroniser.getInput<2>());
+    synchroniser.registerTo(&listener);
+
+    // samples are published in the order of their timestamps, as sensors would deliver them.
+    const int64_t end = 3000 * MILLISECOND;
+    int64_t nextImage = 0;
+    int64_t nextImu = MILLISECOND;
+    int64_t nextOdometry = 3 * MILLISECOND;
+    while (nextImage < end)
+    {
+        if (nextImage <= nextImu && nextImage <= nextOdometry)
+        {
+            camera.publish({nextImage, 0});
+            nextImage += 33 * MILLISECOND;
+        }
+        else if (nextImu <= nextOdometry)
+        {
+            imu.publish({nextImu, 0.0});
+            nextImu += 5 * MILLISECOND;
+        }
+        else
+        {
+            wheels.publish({nextOdometry, 0.0});
+            nextOdometry += 20 * MILLISECOND;
+        }
+    }
+
+    // the IMU sample closest to the latest sample of a set is at most 2.5 ms away from it.
+    long far = 0;
+    for (int64_t distance : listener.mImuDistance)
+    {
+        if (distance * 2 > 5 * MILLISECOND)
+        {
+            ++far;
+        }
+    }
+    printf("Approximate: matched %ld of %ld with %ld errors and %ld IMU samples not the closest \n",
+           listener.mMatched, static_cast<long>(end / (33 * MILLISECOND)) + 1, listener.mErrors, far);
+    return listener.mMatched >= 85 && 0 == listener.mErrors && 0 == far;
+}
+
+/**
+ * Publishes each input from its own thread and checks that matched sets are valid and ordered.
+ */
+static bool testThreads()
+{
+    const int64_t window = 2 * MILLISECOND;
+    const int samples = 20000;
+    SensorTalker<Image> camera;
+    SensorTalker<Imu> imu;
+    SensorTalker<Odometry> wheels;
+    // publishers may run far ahead of each other, so rings hold all samples to check that none is lost.
+    TimeSynchroniser<Image, Imu, Odometry> synchroniser(window, samples, imageStamp, imuStamp, odometryStamp);
+    FusionListener listener(window);
+    camera.registerTo(&synchroniser.getInput<0>());
+    imu.registerTo(&synchroniser.getInput<1>());
+    wheels.registerTo(&synchroniser.getInput<2>());
+    synchroniser.registerTo(&listener);
+
+    std::thread cameraThread([&camera, samples]()
+    {
+        for (int i = 0; i < samples; ++i)
+        {
+            camera.publish({i * 10 * MILLISECOND, i});
+        }
+    });
+    std::thread imuThread([&imu, samples]()
+    {
+        for (int i = 0; i < samples; ++i)
+        {
+            imu.publish({i * 10 * MILLISECOND + MILLISECOND, 0.0});
+        }
+    });
+    std::thread wheelsThread([&wheels, samples]()
+    {
+        for (int i = 0; i < samples; ++i)
+        {
+            wheels.publish({i * 10 * MILLISECOND - MILLISECOND, 0.0});
+        }
+    });
+    cameraThread.join();
+    imuThread.join();
+    wheelsThread.join();
+
+    uint64_t dropped = synchroniser.getInput<0>().getDropped() + synchroniser.getInput<1>().getDropped()
+                     + synchroniser.getInput<2>().getDropped();
+    printf("Threads: matched %ld of %d with %ld errors, %lu samples dropped \n",
+           listener.mMatched, samples, listener.mErrors, static_cast<unsigned long>(dropped));
+    return 0 == listener.mErrors && listener.mMatched > 0 && static_cast<uint64_t>(listener.mMatched) == synchroniser.getMatched()
+        && 0 == dropped && samples - 1 <= listener.mMatched;
+}
+
+int main()
+{
+    bool passed = testExact();
+    passed = testApproximate() && passed;
+    passed = testThreads() && passed;
+    return passed ? 0 : 1;
+}
@@ -21,6 +21,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <cstdio>
+#include <cstring>
 #include <string>
 #include <unistd.h>
 #include <generic_thread.h>
@@ -47,18 +48,97 @@ public:
         return nullptr;
     }
 
+    inline int getCounter() const
+    {
+        return mCounter;
+    }
+
 private:
     int mMaxIter;
     int mCounter;
     std::string mName;
 };
 
+/**
+ * Records the settings its thread actually runs with, so the test can compare them with the requested ones.
+ */
+class SettingsProbe : public GenericThread<SettingsProbe>
+{
+public:
+    SettingsProbe() : GenericThread<SettingsProbe>(), mPolicy(-1), mCpu(-1)
+    {
+        mThreadName[0] = '\0';
+    }
+
+    void* threadBody()
+    {
+        sched_param param;
+        pthread_getschedparam(pthread_self(), &mPolicy, &param);
+        pthread_getname_np(pthread_self(), mThreadName, sizeof(mThreadName));
+        mCpu = sched_getcpu();
+        return nullptr;
+    }
+
+    inline int getPolicy() const
+    {
+        return mPolicy;
+    }
+
+    inline int getCpu() const
+    {
+        return mCpu;
+    }
+
+    inline const char* getThreadName() const
+    {
+        return mThreadName;
+    }
+
+private:
+    int mPolicy;
+    int mCpu;
+    char mThreadName[16];
+};
+
 int main()
 {
     Counter c1(10, "C1");
     Counter c2(40, "C2");
-    c1.startThread();
-    c2.startThread();
-    sleep(1);
-    return 0;
-}
\ No newline at end of file
+    bool ok = c1.startThread();
+    ok = c2.startThread() && ok;
+
+    SettingsProbe configured;
+    ThreadConfig config;
+    config.addCpu(0);
+    config.mName = "probe";
+    config.mStackSize = 256 * 1024;
+    config.mPrefaultSize = 64 * 1024;
+    config.mPolicy = SCHED_FIFO;
+    config.mPriority = 10;
+    ok = configured.startThread(config) && ok;
+    const ThreadConfigStatus& status = configured.getConfigStatus();
+    printf("Settings applied: %d, stack size: %s, scheduling: %s, affinity: %s, name: %s, prefault: %s \n", status.isApplied(),
+           strerror(status.mStackSize), strerror(status.mScheduling), strerror(status.mAffinity), strerror(status.mName),
+           strerror(status.mPrefaultSize));
+    ok = ok && 0 == status.mStackSize && 0 == status.mAffinity && 0 == status.mName && 0 == status.mPrefaultSize;
+    // real-time scheduling needs CAP_SYS_NICE, without it the thread keeps running with the default policy.
+    ok = ok && (0 == status.mScheduling || EPERM == status.mScheduling);
+
+    // a prefault larger than the whole stack is limited to the free part of it instead of overflowing.
+    SettingsProbe oversized;
+    ThreadConfig oversizedConfig;
+    oversizedConfig.mStackSize = 256 * 1024;
+    oversizedConfig.mPrefaultSize = 1024 * 1024;
+    ok = oversized.startThread(oversizedConfig) && ok;
+    ok = ok && ERANGE == oversized.getConfigStatus().mPrefaultSize && !oversized.getConfigStatus().isApplied();
+
+    c1.stopThread();
+    c2.stopThread();
+    configured.stopThread();
+    oversized.stopThread();
+    ok = ok && 10 == c1.getCounter() && 40 == c2.getCounter() && 50 == globalCounter.load();
+    ok = ok && 0 == strcmp("probe", configured.getThreadName()) && 0 == configured.getCpu();
+    ok = ok && (0 == status.mScheduling ? SCHED_FIFO : SCHED_OTHER) == configured.getPolicy();
+    printf("Thread configuration: %s \n", ok ? "passed" : "failed");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2023 Mateusz Malinowski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <time.h>
+#include <unistd.h>
+#include <generic_listener.h>
+#include <generic_talker.h>
+#include <thread_pool.h>
+
+
+class HeavyListener : public GenericListener<double>
+{
+public:
+    HeavyListener() : mCounter(0), mResult(0.0), mLast(-1.0), mOutOfOrder(0) {}
+
+    void update(const double& value) override
+    {
+        double result = value;
+        for (int i = 0; i < 20000; ++i)
+        {
+            result = std::sin(result) + value;
+        }
+        // plain members are safe as long as updates of a listener never overlap.
+        mResult = result;
+        mOutOfOrder += value <= mLast ? 1 : 0;
+        mLast = value;
+        mCounter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<int> mCounter;
+    double mResult;
+    double mLast;
+    int mOutOfOrder;
+};
+
+class MyTalker : public GenericTalker<double>
+{
+public:
+    explicit MyTalker(const BroadcastMode mode) : GenericTalker<double>(mode) {}
+
+    void publish(const double value)
+    {
+        notifyListeners(value);
+    }
+};
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+/**
+ * Publishes a few samples to 32 listeners and checks that all of them were updated.
+ */
+static bool runTest(const char* name, const BroadcastMode mode, ThreadPool* pool, const bool wait)
+{
+    MyTalker talker(mode);
+    HeavyListener listeners[32];
+    for (HeavyListener& listener : listeners)
+    {
+        talker.registerTo(&listener);
+    }
+    talker.setThreadPool(pool, wait);
+
+    double start = now();
+    for (int i = 0; i < 10; ++i)
+    {
+        talker.publish(static_cast<double>(i));
+    }
+    double elapsed = now() - start;
+    // unregistering waits for broadcasts that were not waited for.
+    talker.unregisterAll();
+
+    bool ok = true;
+    for (HeavyListener& listener : listeners)
+    {
+        ok &= (10 == listener.mCounter.load() && 0 == listener.mOutOfOrder);
+    }
+    printf("%s: publishing took %f s, all listeners updated in order: %d \n", name, elapsed, ok);
+    return ok;
+}
+
+struct Fibonacci
+{
+    ThreadPool* mPool;
+    std::atomic<long> mCalls;
+};
+
+/**
+ * Submits two more tasks from within a task, which keeps workers stealing from each other.
+ */
+static void spawn(void* context, size_t depth)
+{
+    Fibonacci* fibonacci = static_cast<Fibonacci*>(context);
+    fibonacci->mCalls.fetch_add(1);
+    if (depth > 1)
+    {
+        fibonacci->mPool->submit({spawn, context, depth - 1});
+        fibonacci->mPool->submit({spawn, context, depth - 2});
+    }
+}
+
+struct Blocker
+{
+    std::atomic<int> mStarted;
+    std::atomic<bool> mDone;
+    std::atomic<bool> mOverlapped;
+    std::atomic<bool> mReturned;
+};
+
+/**
+ * Blocks its worker until another task is done, for at most two seconds.
+ */
+static void block(void* context, size_t)
+{
+    Blocker* blocker = static_cast<Blocker*>(context);
+    blocker->mStarted.fetch_add(1);
+    double deadline = now() + 2.0;
+    while (!blocker->mDone.load() && now() < deadline)
+    {
+        usleep(1000);
+    }
+    blocker->mOverlapped.store(blocker->mDone.load());
+    blocker->mReturned.store(true);
+}
+
+static void start(void* context, size_t)
+{
+    static_cast<Blocker*>(context)->mStarted.fetch_add(1);
+}
+
+static void finish(void* context, size_t)
+{
+    static_cast<Blocker*>(context)->mDone.store(true);
+}
+
+/**
+ * Submits a task to a busy worker and checks that the idle worker runs it.
+ */
+static bool runBusyTest(ThreadPool& pool)
+{
+    Blocker blocker{{0}, {false}, {false}, {false}};
+    pool.submit({block, &blocker, 0});
+    // the second task goes to the other worker in turn, so the third one goes to the busy worker.
+    pool.submit({start, &blocker, 0});
+    while (blocker.mStarted.load() < 2)
+    {
+        usleep(1000);
+    }
+    // lets the other worker go idle.
+    usleep(50000);
+    pool.submit({finish, &blocker, 0});
+    while (!blocker.mReturned.load())
+    {
+        usleep(1000);
+    }
+    bool ok = blocker.mOverlapped.load();
+    printf("Busy worker: task run by the idle worker: %d \n", ok);
+    return ok;
+}
+
+int main()
+{
+    ThreadPool pool(4);
+
+    bool ok = runTest("Sequential", BroadcastMode::EXCLUSIVE, nullptr, true);
+    ok &= runTest("Parallel, exclusive, waiting", BroadcastMode::EXCLUSIVE, &pool, true);
+    ok &= runTest("Parallel, snapshot, waiting", BroadcastMode::SNAPSHOT, &pool, true);
+    ok &= runTest("Parallel, exclusive, detached", BroadcastMode::EXCLUSIVE, &pool, false);
+    ok &= runTest("Parallel, snapshot, detached", BroadcastMode::SNAPSHOT, &pool, false);
+
+    // a pool asked for no workers still gets one, so detached broadcasts make progress.
+    ThreadPool single(0);
+    ok &= (1 == single.getWorkerCount());
+    ok &= runTest("Single worker, detached", BroadcastMode::EXCLUSIVE, &single, false);
+
+    ThreadPool pair(2);
+    ok &= runBusyTest(pair);
+
+    Fibonacci fibonacci{&pool, {0}};
+    pool.submit({spawn, &fibonacci, 20});
+    // calls(n) = calls(n - 1) + calls(n - 2) + 1 with calls(0) = calls(1) = 1.
+    long expected = 21891;
+    while (fibonacci.mCalls.load() != expected)
+    {
+        pool.runPending();
+    }
+    printf("Recursive tasks: %ld \n", fibonacci.mCalls.load());
+
+    return ok ? 0 : 1;
+}